@@ -0,0 +1,118 @@
+#include <benchmark/benchmark.h>
+
+#include <coroutine>
+#include <memory>
+#include <type_traits>
+#include "timekeeper/coroutine.hpp"
+
+// 协程上下文的开销：每次挂起/恢复时的摘下和挂上，以及协程 span
+// 每次迭代恢复一次常驻的协程，协程做完一步后再次挂起
+
+namespace {
+
+template <typename Base>
+class Loop {
+public:
+    struct promise_type : Base {
+        static constexpr bool kHasContext = std::is_base_of_v<timekeeper::CoroutineContext, Base>;
+
+        Loop get_return_object() {
+            return Loop(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        // 带上下文时按 CoroutineContext 的约定：initial_suspend 用 wrap 包一下，final_suspend 前先摘下上下文
+        auto initial_suspend() {
+            if constexpr (kHasContext) {
+                return this->wrap(std::suspend_always{});
+            } else {
+                return std::suspend_always{};
+            }
+        }
+        std::suspend_always final_suspend() noexcept {
+            if constexpr (kHasContext) {
+                this->detach();
+            }
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    explicit Loop(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+    Loop(const Loop &) = delete;
+    Loop& operator=(const Loop &) = delete;
+    ~Loop() { _handle.destroy(); }
+
+    void resume() { _handle.resume(); }
+
+private:
+    std::coroutine_handle<promise_type> _handle;
+};
+
+struct NoContext {};
+
+struct WithContext : timekeeper::CoroutineContext {
+    WithContext() {
+        set_context(timekeeper::Context(std::make_shared<timekeeper::ThreadData>("bench")));
+    }
+};
+
+Loop<NoContext> suspend_plain() {
+    while (true) {
+        co_await std::suspend_always{};
+    }
+}
+
+Loop<WithContext> suspend_with_context() {
+    while (true) {
+        co_await std::suspend_always{};
+    }
+}
+
+Loop<WithContext> suspend_with_span() {
+    timekeeper::CoroutineSpan span(co_await timekeeper::this_coroutine, "outer");
+    while (true) {
+        co_await std::suspend_always{};
+    }
+}
+
+Loop<WithContext> span_per_step() {
+    while (true) {
+        {
+            timekeeper::CoroutineSpan span(co_await timekeeper::this_coroutine, "step");
+        }
+        co_await std::suspend_always{};
+    }
+}
+
+template <typename LoopType>
+void run(benchmark::State& state, LoopType loop) {
+    loop.resume();
+    for (auto _ : state) {
+        loop.resume();
+    }
+}
+
+}  // namespace
+
+static void BM_CoroutineResumePlain(benchmark::State& state) {
+    run(state, suspend_plain());
+}
+BENCHMARK(BM_CoroutineResumePlain);
+
+// 每次挂起/恢复多一次摘下和挂上
+static void BM_CoroutineResumeWithContext(benchmark::State& state) {
+    run(state, suspend_with_context());
+}
+BENCHMARK(BM_CoroutineResumeWithContext);
+
+// 有一个活跃 span 时，挂起和恢复还要暂停、恢复 span 的计时
+static void BM_CoroutineResumeWithSpan(benchmark::State& state) {
+    run(state, suspend_with_span());
+}
+BENCHMARK(BM_CoroutineResumeWithSpan);
+
+// 每步建立并提交一个协程 span，减去 BM_CoroutineResumeWithContext 即为 span 本身的开销
+static void BM_CoroutineSpanPerStep(benchmark::State& state) {
+    run(state, span_per_step());
+}
+BENCHMARK(BM_CoroutineSpanPerStep);
@@ -0,0 +1,109 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "timekeeper/timekeeper.hpp"
+
+// HierarchicalMap 的查找、插入、删除
+
+namespace {
+
+using Map = timekeeper::HierarchicalMap<int>;
+
+std::vector<std::string> make_keys(size_t n, const std::string& prefix) {
+    std::vector<std::string> keys;
+    keys.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys.push_back(prefix + std::to_string(i));
+    }
+    return keys;
+}
+
+}  // namespace
+
+// 在 map 里有 range(0) 个 key 时查找
+static void BM_HierarchicalMapFind(benchmark::State& state) {
+    static Map* map = nullptr;
+    static std::vector<std::string> keys;
+    if (state.thread_index() == 0) {
+        map = new Map();
+        keys = make_keys(state.range(0), "key_");
+        for (auto& key : keys) {
+            map->AddData(key, std::make_shared<int>(0));
+        }
+    }
+    size_t i = state.thread_index();
+    for (auto _ : state) {
+        auto data = map->FindData(keys[i++ % keys.size()]);
+        benchmark::DoNotOptimize(data.get());
+    }
+    if (state.thread_index() == 0) {
+        delete map;
+        map = nullptr;
+    }
+}
+BENCHMARK(BM_HierarchicalMapFind)->Arg(100)->Arg(10000);
+BENCHMARK(BM_HierarchicalMapFind)->Arg(10000)->ThreadRange(2, 16)->UseRealTime();
+
+// 插入一个 key，取 KeyGuard，释放时删除
+static void BM_HierarchicalMapAddRemove(benchmark::State& state) {
+    static Map* map = nullptr;
+    if (state.thread_index() == 0) {
+        map = new Map();
+    }
+    auto keys = make_keys(1024, "key_" + std::to_string(state.thread_index()) + "_");
+    auto value = std::make_shared<int>(0);
+    size_t i = 0;
+    for (auto _ : state) {
+        const std::string& key = keys[i++ & 1023];
+        map->AddData(key, value);
+        auto guard = map->GetKeyGuard(key);
+        benchmark::DoNotOptimize(guard.get());
+    }
+    if (state.thread_index() == 0) {
+        delete map;
+        map = nullptr;
+    }
+}
+BENCHMARK(BM_HierarchicalMapAddRemove)->ThreadRange(1, 64)->UseRealTime();
+
+// 带 range(0) 个子 key 的父 key 的插入和删除，子 key 在后续的插入里分摊回收
+static void BM_HierarchicalMapRemoveTree(benchmark::State& state) {
+    Map map;
+    const size_t children = state.range(0);
+    auto keys = make_keys(children, "child_");
+    auto value = std::make_shared<int>(0);
+    for (auto _ : state) {
+        map.AddData("parent", value);
+        for (auto& key : keys) {
+            map.AddData(key, nullptr, "parent");
+        }
+        auto guard = map.GetKeyGuard("parent");
+        benchmark::DoNotOptimize(guard.get());
+    }
+    state.SetItemsProcessed(state.iterations() * (children + 1));
+}
+BENCHMARK(BM_HierarchicalMapRemoveTree)->Arg(1)->Arg(16)->Arg(256);
+
+// 只计删除父 key（释放 KeyGuard）本身的耗时：摘下节点是 O(1)，删除时不回收子 key，耗时不随子 key 数量线性增长
+static void BM_HierarchicalMapUnlinkTree(benchmark::State& state) {
+    Map map;
+    const size_t children = state.range(0);
+    auto keys = make_keys(children, "child_");
+    auto value = std::make_shared<int>(0);
+    for (auto _ : state) {
+        map.AddData("parent", value);
+        for (auto& key : keys) {
+            map.AddData(key, nullptr, "parent");
+        }
+        auto guard = map.GetKeyGuard("parent");
+        auto begin = std::chrono::steady_clock::now();
+        guard.reset();
+        auto end = std::chrono::steady_clock::now();
+        state.SetIterationTime(std::chrono::duration<double>(end - begin).count());
+        map.ReclaimAll();
+    }
+}
+BENCHMARK(BM_HierarchicalMapUnlinkTree)->Arg(1)->Arg(16)->Arg(256)->UseManualTime();
@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "timekeeper/otlp_exporter.hpp"
+
+// OTLP/JSON 导出的吞吐，items_per_second 是每秒处理的 span 数（含每个请求的根 span）
+
+namespace {
+
+std::vector<timekeeper::RequestRecord> make_records(size_t requests, size_t spans) {
+    std::vector<timekeeper::RequestRecord> records(requests);
+    int64_t base = 1700000000000000;
+    for (size_t i = 0; i < requests; ++i) {
+        auto& record = records[i];
+        record.logid = "request_" + std::to_string(i);
+        record.fields.emplace_back("priority", timekeeper::LogValue(std::string_view("high")));
+        record.fields.emplace_back("retry", timekeeper::LogValue(int64_t(0)));
+        // 一层嵌套：main 包含其余 span
+        record.spans.push_back({"main_process", base, base + 1000 * static_cast<int64_t>(spans)});
+        for (size_t j = 1; j < spans; ++j) {
+            int64_t start = base + 1000 * static_cast<int64_t>(j);
+            record.spans.push_back({"step" + std::to_string(j), start, start + 900});
+        }
+    }
+    return records;
+}
+
+class NullSink : public timekeeper::Sink {
+public:
+    void write(std::string_view data) override { benchmark::DoNotOptimize(data.data()); }
+    void flush() override {}
+};
+
+}  // namespace
+
+// 单核格式化：每次迭代格式化一批请求
+static void BM_OtlpFormatBatch(benchmark::State& state) {
+    const size_t batch = 64;
+    const size_t spans = state.range(0);
+    auto records = make_records(batch, spans);
+    timekeeper::OtlpJsonFormatter formatter("bench");
+    std::string out;
+    for (auto _ : state) {
+        out.clear();
+        formatter.begin_batch(out);
+        for (auto& record : records) {
+            formatter.append(out, record);
+        }
+        formatter.end_batch(out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * batch * (spans + 1));
+    state.SetBytesProcessed(state.iterations() * out.size());
+}
+BENCHMARK(BM_OtlpFormatBatch)->Arg(4)->Arg(10)->Arg(50);
+
+// 端到端：请求线程入队，后台线程格式化后写到空 Sink
+static void BM_OtlpExporterEndToEnd(benchmark::State& state) {
+    const size_t spans = 10;
+    auto records = make_records(1024, spans);
+    timekeeper::OtlpJsonExporter::Options options;
+    options.policy = timekeeper::AsyncEmitter::OverflowPolicy::kBlock;
+    timekeeper::OtlpJsonExporter exporter(std::make_shared<NullSink>(), options);
+    size_t i = 0;
+    for (auto _ : state) {
+        timekeeper::RequestRecord record = records[i++ & 1023];
+        exporter.push(std::move(record));
+    }
+    exporter.flush();
+    state.SetItemsProcessed(state.iterations() * (spans + 1));
+}
+BENCHMARK(BM_OtlpExporterEndToEnd)->UseRealTime();
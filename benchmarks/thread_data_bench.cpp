@@ -0,0 +1,178 @@
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "timekeeper/timekeeper.hpp"
+
+// ThreadData 和 ThreadDataManager 的开销
+
+// 字符串字段，key 在 16 个之间循环，大部分是首次写入生效的重复 key
+static void BM_ThreadDataAddLogFieldString(benchmark::State& state) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 16; ++i) {
+        keys.push_back("field_" + std::to_string(i));
+    }
+    timekeeper::ThreadData data("bench");
+    size_t i = 0;
+    for (auto _ : state) {
+        data.add_log_field(keys[i++ & 15], "value");
+    }
+}
+BENCHMARK(BM_ThreadDataAddLogFieldString);
+
+static void BM_ThreadDataAddLogFieldInt(benchmark::State& state) {
+    timekeeper::ThreadData data("bench");
+    int64_t i = 0;
+    for (auto _ : state) {
+        data.add_log_field("retry_count", i++, true);
+    }
+}
+BENCHMARK(BM_ThreadDataAddLogFieldInt);
+
+// 多线程向同一个请求写字段
+static void BM_ThreadDataAddLogFieldContended(benchmark::State& state) {
+    static std::unique_ptr<timekeeper::ThreadData> data;
+    if (state.thread_index() == 0) {
+        data = std::make_unique<timekeeper::ThreadData>("bench");
+    }
+    const std::string key = "thread_" + std::to_string(state.thread_index());
+    int64_t i = 0;
+    for (auto _ : state) {
+        data->add_log_field(key, i++, true);
+    }
+    if (state.thread_index() == 0) {
+        data.reset();
+    }
+}
+BENCHMARK(BM_ThreadDataAddLogFieldContended)->ThreadRange(1, 16)->UseRealTime();
+
+// 通过 ThreadData 建立记录，比 TimeCounter 多一层锁
+static void BM_ThreadDataAddRecorder(benchmark::State& state) {
+    auto data = std::make_unique<timekeeper::ThreadData>("bench");
+    size_t i = 0;
+    for (auto _ : state) {
+        {
+            auto recorder = data->add_recorder("step");
+            benchmark::DoNotOptimize(recorder.get());
+        }
+        if (++i % 65536 == 0) {
+            data = std::make_unique<timekeeper::ThreadData>("bench");
+        }
+    }
+}
+BENCHMARK(BM_ThreadDataAddRecorder);
+
+// 导入 range(0) 个外部测得的分段耗时：逐个 add_sample 和一次 add_spans
+static std::vector<timekeeper::SpanRecord> make_spans(size_t n) {
+    std::vector<timekeeper::SpanRecord> spans;
+    for (size_t i = 0; i < n; ++i) {
+        spans.push_back(timekeeper::SpanRecord{"remote_step_" + std::to_string(i),
+                static_cast<int64_t>(i), static_cast<int64_t>(i + 10)});
+    }
+    return spans;
+}
+
+static void BM_ThreadDataImportSpansOneByOne(benchmark::State& state) {
+    auto spans = make_spans(state.range(0));
+    for (auto _ : state) {
+        timekeeper::ThreadData data("bench");
+        for (auto& span : spans) {
+            data.add_sample(span.name, timekeeper::TimeRecorder::Sample{span.start_us, span.end_us, span.metrics});
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * spans.size());
+}
+BENCHMARK(BM_ThreadDataImportSpansOneByOne)->Arg(8)->Arg(64);
+
+static void BM_ThreadDataAddSpans(benchmark::State& state) {
+    auto spans = make_spans(state.range(0));
+    for (auto _ : state) {
+        timekeeper::ThreadData data("bench");
+        data.add_spans(spans);
+    }
+    state.SetItemsProcessed(state.iterations() * spans.size());
+}
+BENCHMARK(BM_ThreadDataAddSpans)->Arg(8)->Arg(64);
+
+// 一次写入 range(0) 个字段
+static void BM_ThreadDataAddLogFields(benchmark::State& state) {
+    std::vector<std::pair<std::string, timekeeper::LogValue>> fields;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        fields.emplace_back("field_" + std::to_string(i), timekeeper::LogValue(i));
+    }
+    for (auto _ : state) {
+        timekeeper::ThreadData data("bench");
+        data.add_log_fields(fields);
+    }
+    state.SetItemsProcessed(state.iterations() * fields.size());
+}
+BENCHMARK(BM_ThreadDataAddLogFields)->Arg(8)->Arg(64);
+
+// 一个请求的完整生命周期：Init、取 KeyGuard、释放后从 map 删除
+static void BM_ThreadDataManagerLifecycle(benchmark::State& state) {
+    auto& manager = timekeeper::ThreadDataManager::Instance();
+    const std::string prefix = "logid_" + std::to_string(state.thread_index()) + "_";
+    size_t i = 0;
+    for (auto _ : state) {
+        auto data = manager.Init(prefix + std::to_string(i++));
+        auto guard = manager.GetKeyGuard();
+        benchmark::DoNotOptimize(guard.get());
+    }
+}
+BENCHMARK(BM_ThreadDataManagerLifecycle)->ThreadRange(1, 64)->UseRealTime();
+
+// 重复 logid（上游重试）：每次 Init 都命中已有的 key，登记为别名
+static void BM_ThreadDataManagerDuplicateLogid(benchmark::State& state) {
+    auto& manager = timekeeper::ThreadDataManager::Instance();
+    static std::shared_ptr<timekeeper::ThreadData> owner;
+    if (state.thread_index() == 0) {
+        // key 的所有者在另一个线程上，benchmark 线程的 Init 都走别名路径
+        std::thread([&manager] {
+            manager.Init("duplicate_logid");
+            owner = manager.GetKeyGuard();
+        }).join();
+    }
+    for (auto _ : state) {
+        auto data = manager.Init("duplicate_logid");
+        auto guard = manager.GetKeyGuard();
+        benchmark::DoNotOptimize(guard.get());
+    }
+    if (state.thread_index() == 0) {
+        owner.reset();
+    }
+}
+BENCHMARK(BM_ThreadDataManagerDuplicateLogid)->ThreadRange(1, 64)->UseRealTime();
+
+// 请求内反复取当前线程的数据
+static void BM_ThreadDataManagerGetCurrent(benchmark::State& state) {
+    auto& manager = timekeeper::ThreadDataManager::Instance();
+    {
+        auto data = manager.Init("current_" + std::to_string(state.thread_index()));
+        auto guard = manager.GetKeyGuard();
+        for (auto _ : state) {
+            auto current = manager.GetCurrentThreadData();
+            benchmark::DoNotOptimize(current.get());
+        }
+    }
+}
+BENCHMARK(BM_ThreadDataManagerGetCurrent)->ThreadRange(1, 16)->UseRealTime();
+
+// 挂上 Context 后取当前数据，不经过全局 map
+static void BM_ThreadDataManagerGetCurrentAttached(benchmark::State& state) {
+    auto& manager = timekeeper::ThreadDataManager::Instance();
+    timekeeper::Context context;
+    {
+        auto data = manager.Init("attached_" + std::to_string(state.thread_index()));
+        context = manager.Capture();
+    }
+    {
+        timekeeper::ContextScope scope(context);
+        for (auto _ : state) {
+            auto current = manager.GetCurrentThreadData();
+            benchmark::DoNotOptimize(current.get());
+        }
+    }
+}
+BENCHMARK(BM_ThreadDataManagerGetCurrentAttached)->ThreadRange(1, 16)->UseRealTime();
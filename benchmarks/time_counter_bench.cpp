@@ -0,0 +1,175 @@
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "timekeeper/time_counter.hpp"
+
+// TimeRecorder / TimeCounter 本身的开销
+
+namespace {
+
+std::vector<std::string> make_names(size_t n) {
+    std::vector<std::string> names;
+    names.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        names.push_back("span_" + std::to_string(i));
+    }
+    return names;
+}
+
+}  // namespace
+
+// 单个 TimeRecorder 的 构造 + start + end（含上传回调），回调为空操作
+static void BM_TimeRecorderStartEnd(benchmark::State& state) {
+    const std::string name = "step";
+    auto cb = [](const std::string&, const timekeeper::TimeRecorder::Sample& sample) {
+        benchmark::DoNotOptimize(sample.end_us);
+    };
+    for (auto _ : state) {
+        timekeeper::TimeRecorder recorder(name, cb);
+        recorder.start();
+        recorder.end();
+    }
+}
+BENCHMARK(BM_TimeRecorderStartEnd);
+
+// add_recorder 后立即释放，同名合并路径
+static void BM_TimeCounterAddRecorder(benchmark::State& state) {
+    const std::string name = "step";
+    auto counter = std::make_unique<timekeeper::TimeCounter>();
+    size_t i = 0;
+    for (auto _ : state) {
+        {
+            auto recorder = counter->add_recorder(name);
+            benchmark::DoNotOptimize(recorder.get());
+        }
+        // _trs 里的弱引用会让记录的内存一直占着，定期换一个 counter，摊到每次迭代上可以忽略
+        if (++i % 65536 == 0) {
+            counter = std::make_unique<timekeeper::TimeCounter>();
+        }
+    }
+}
+BENCHMARK(BM_TimeCounterAddRecorder);
+
+// 同一个 TimeCounter 上多线程并发 add_recorder，每个线程用不同的名字
+static void BM_TimeCounterAddRecorderContended(benchmark::State& state) {
+    static std::unique_ptr<timekeeper::TimeCounter> counter;
+    if (state.thread_index() == 0) {
+        counter = std::make_unique<timekeeper::TimeCounter>();
+    }
+    const std::string name = "thread_" + std::to_string(state.thread_index());
+    for (auto _ : state) {
+        auto recorder = counter->add_recorder(name);
+        benchmark::DoNotOptimize(recorder.get());
+    }
+    if (state.thread_index() == 0) {
+        counter.reset();
+    }
+}
+BENCHMARK(BM_TimeCounterAddRecorderContended)->ThreadRange(1, 16)->UseRealTime();
+
+// report 的开销，span 数为参数；所有记录都已结束，每次只做收集和格式化
+static void BM_TimeCounterReport(benchmark::State& state) {
+    const size_t spans = state.range(0);
+    auto names = make_names(spans);
+    timekeeper::TimeCounter counter;
+    for (auto& name : names) {
+        counter.add_recorder(name);
+    }
+    for (auto _ : state) {
+        std::string report = counter.report();
+        benchmark::DoNotOptimize(report.data());
+    }
+    state.SetItemsProcessed(state.iterations() * spans);
+}
+BENCHMARK(BM_TimeCounterReport)->Arg(10)->Arg(100)->Arg(1000);
+
+// range(0) 个已完成的 span、一个未结束的记录，每次快照前只有一个 span 有新记录
+static void BM_TimeCounterSnapshot(benchmark::State& state) {
+    const size_t spans = state.range(0);
+    const bool incremental = state.range(1) != 0;
+    auto names = make_names(spans);
+    timekeeper::TimeCounter counter;
+    for (auto& name : names) {
+        counter.add_recorder(name);
+    }
+    auto live = counter.add_recorder("live");
+    size_t i = 0;
+    for (auto _ : state) {
+        counter.add_recorder(names[i++ % spans]);
+        std::vector<timekeeper::SpanRecord> out;
+        counter.snapshot(out, incremental);
+        std::string text;
+        timekeeper::append_spans_text(text, out);
+        benchmark::DoNotOptimize(text.data());
+    }
+}
+BENCHMARK(BM_TimeCounterSnapshot)->Args({100, 0})->Args({100, 1})->Args({1000, 0})->Args({1000, 1});
+
+// 合并下游返回的 range(0) 个 span
+static void BM_TimeCounterMergeRemote(benchmark::State& state) {
+    const size_t spans = state.range(0);
+    auto names = make_names(spans);
+    std::string bytes;
+    {
+        timekeeper::TimeCounter remote;
+        for (auto& name : names) {
+            remote.add_recorder(name);
+        }
+        remote.serialize_spans(bytes);
+    }
+    for (auto _ : state) {
+        timekeeper::TimeCounter counter;
+        benchmark::DoNotOptimize(counter.merge_remote("remote.", bytes, 1, 1000));
+    }
+    state.SetItemsProcessed(state.iterations() * spans);
+    state.counters["bytes"] = static_cast<double>(bytes.size());
+}
+BENCHMARK(BM_TimeCounterMergeRemote)->Arg(10)->Arg(100);
+
+// 含未结束记录时的 report：要先结束所有存活的记录
+static void BM_TimeCounterReportLive(benchmark::State& state) {
+    const size_t spans = state.range(0);
+    auto names = make_names(spans);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto counter = std::make_unique<timekeeper::TimeCounter>();
+        std::vector<std::shared_ptr<timekeeper::TimeRecorder>> live;
+        live.reserve(spans);
+        for (auto& name : names) {
+            live.push_back(counter->add_recorder(name));
+        }
+        state.ResumeTiming();
+
+        std::string report = counter->report();
+        benchmark::DoNotOptimize(report.data());
+
+        state.PauseTiming();
+        live.clear();
+        counter.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * spans);
+}
+BENCHMARK(BM_TimeCounterReportLive)->Arg(10)->Arg(100)->Arg(1000);
+
+// 打开开销统计后的 add_recorder，和 BM_TimeCounterAddRecorder 对比即为统计本身的代价
+static void BM_TimeCounterAddRecorderWithOverhead(benchmark::State& state) {
+    auto& overhead = timekeeper::Overhead::Instance();
+    overhead.set_enabled(true);
+    const std::string name = "step";
+    auto counter = std::make_unique<timekeeper::TimeCounter>();
+    size_t i = 0;
+    for (auto _ : state) {
+        {
+            auto recorder = counter->add_recorder(name);
+            benchmark::DoNotOptimize(recorder.get());
+        }
+        if (++i % 65536 == 0) {
+            counter = std::make_unique<timekeeper::TimeCounter>();
+        }
+    }
+    overhead.set_enabled(false);
+}
+BENCHMARK(BM_TimeCounterAddRecorderWithOverhead);
@@ -0,0 +1,59 @@
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "timekeeper/timekeeper.hpp"
+
+// 堆分配统计：链接 timekeeper_alloc 后，打开 kProbeAlloc 的 span 会带上 "alloc: 字节数(B)/次数"
+// 每个 span 只统计自己这一层，嵌套的 span 里的分配记在内层
+
+void build_index(timekeeper::ThreadData& data) {
+    auto timer = data.add_recorder("build_index");
+    std::map<int, std::string> index;
+    for (int i = 0; i < 1000; ++i) {
+        index.emplace(i, "value_" + std::to_string(i) + "_padding_to_defeat_sso");
+    }
+}
+
+void parse_request(timekeeper::ThreadData& data) {
+    auto timer = data.add_recorder("parse_request");
+    std::vector<int> tokens;
+    tokens.reserve(4096);
+    {
+        // 内层 span 的分配不计入 parse_request
+        auto inner = data.add_recorder("tokenize");
+        std::vector<std::string> words;
+        for (int i = 0; i < 100; ++i) {
+            words.emplace_back(64, 'x');
+        }
+    }
+}
+
+int main() {
+    if (!timekeeper::alloc::hooks_installed()) {
+        std::cerr << "operator new 没有被替换，检查是否链接了 timekeeper_alloc" << std::endl;
+        return 1;
+    }
+
+    auto guard = timekeeper::ThreadDataManager::Instance().Init("alloc_demo");
+    guard->set_probes(timekeeper::kProbeAlloc);
+
+    {
+        auto total = guard->add_recorder("handle");
+        parse_request(*guard);
+        build_index(*guard);
+        // 不分配的 span
+        auto idle = guard->add_recorder("no_alloc");
+    }
+
+    // 注册记录、上传合并这些 timekeeper 自己的分配不计入 span
+    for (auto& span : guard->make_snapshot().spans) {
+        if (span.name == "no_alloc" && (span.metrics.alloc_bytes != 0 || span.metrics.alloc_count != 0)) {
+            std::cerr << "no_alloc 不应该有分配" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << guard->report() << std::endl;
+    return 0;
+}
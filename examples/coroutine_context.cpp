@@ -0,0 +1,248 @@
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <functional>
+#include <iostream>
+#include <latch>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "timekeeper/coroutine.hpp"
+
+// C++20 协程里的上下文传递和 span
+// 请求在 co_await 之间会换到线程池的不同线程上执行，
+// GetCurrentThreadData() 始终返回这个请求的数据，协程 span 区分运行时间和挂起时间
+
+namespace {
+
+// 简单的线程池，外加一个定时线程，用来模拟异步 IO 完成后在线程池上恢复协程
+class Executor {
+public:
+    explicit Executor(int threads) {
+        for (int i = 0; i < threads; ++i) {
+            _workers.emplace_back([this] { work(); });
+        }
+        _timer = std::thread([this] { timer(); });
+    }
+
+    ~Executor() {
+        {
+            std::lock_guard lock(_mtx);
+            _stop = true;
+        }
+        _cv.notify_all();
+        _timer_cv.notify_all();
+        for (auto& t : _workers) {
+            t.join();
+        }
+        _timer.join();
+    }
+
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard lock(_mtx);
+            _tasks.push(std::move(task));
+        }
+        _cv.notify_one();
+    }
+
+    void post_after(std::chrono::milliseconds delay, std::function<void()> task) {
+        {
+            std::lock_guard lock(_mtx);
+            _timers.emplace(std::chrono::steady_clock::now() + delay, std::move(task));
+        }
+        _timer_cv.notify_one();
+    }
+
+private:
+    void work() {
+        std::unique_lock lock(_mtx);
+        while (true) {
+            _cv.wait(lock, [this] { return _stop || !_tasks.empty(); });
+            if (_tasks.empty()) {
+                return;
+            }
+            auto task = std::move(_tasks.front());
+            _tasks.pop();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    void timer() {
+        std::unique_lock lock(_mtx);
+        while (!_stop) {
+            if (_timers.empty()) {
+                _timer_cv.wait(lock);
+                continue;
+            }
+            auto it = _timers.begin();
+            if (_timer_cv.wait_until(lock, it->first) == std::cv_status::timeout) {
+                it = _timers.begin();
+                if (it->first <= std::chrono::steady_clock::now()) {
+                    _tasks.push(std::move(it->second));
+                    _timers.erase(it);
+                    _cv.notify_one();
+                }
+            }
+        }
+    }
+
+    std::mutex _mtx;
+    std::condition_variable _cv, _timer_cv;
+    std::queue<std::function<void()>> _tasks;
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> _timers;
+    std::vector<std::thread> _workers;
+    std::thread _timer;
+    bool _stop = false;
+};
+
+// co_await 后在线程池上恢复，delay 模拟 IO 等待
+struct ResumeOn {
+    Executor& executor;
+    std::chrono::milliseconds delay{0};
+
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        if (delay.count() > 0) {
+            executor.post_after(delay, [handle] { handle.resume(); });
+        } else {
+            executor.post([handle] { handle.resume(); });
+        }
+    }
+    void await_resume() {}
+};
+
+// 惰性的子任务，被 co_await 时才开始执行，结束后回到调用方
+class Task {
+public:
+    struct promise_type : timekeeper::CoroutineContext {
+        std::coroutine_handle<> continuation;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        // 自定义 initial_suspend 时用 wrap 包一下，第一次恢复时挂上上下文
+        auto initial_suspend() {
+            return wrap(std::suspend_always{});
+        }
+
+        struct Final {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                return handle.promise().continuation;
+            }
+            void await_resume() noexcept {}
+        };
+
+        // 自定义 final_suspend 时先摘下上下文
+        Final final_suspend() noexcept {
+            detach();
+            return {};
+        }
+
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+    Task(Task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+    ~Task() {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    bool await_ready() { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) {
+        _handle.promise().continuation = continuation;
+        return _handle;
+    }
+    void await_resume() {}
+
+private:
+    std::coroutine_handle<promise_type> _handle;
+};
+
+// 顶层请求：立即开始执行，结束后自己销毁
+// 每个请求有自己的 ThreadData，在 promise 构造时通过 set_context 指定
+struct Request {
+    struct promise_type : timekeeper::CoroutineContext {
+        promise_type(Executor&, const std::string& logid, std::latch&) {
+            set_context(timekeeper::Context(std::make_shared<timekeeper::ThreadData>(logid)));
+        }
+
+        Request get_return_object() { return {}; }
+        std::suspend_never final_suspend() noexcept {
+            detach();
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+std::mutex output_mutex;
+
+void busy_for(std::chrono::milliseconds duration) {
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < deadline) {
+    }
+}
+
+std::string thread_name() {
+    std::ostringstream ss;
+    ss << std::this_thread::get_id();
+    return ss.str();
+}
+
+Task fetch(Executor& executor, std::string name) {
+    timekeeper::CoroutineSpan span(co_await timekeeper::this_coroutine, name);
+    busy_for(std::chrono::milliseconds(1));
+    co_await ResumeOn{executor, std::chrono::milliseconds(20)};
+    busy_for(std::chrono::milliseconds(1));
+    auto data = timekeeper::ThreadDataManager::Instance().GetCurrentThreadData();
+    data->add_log_field(name + "_thread", thread_name());
+}
+
+// logid 只由 promise_type 的构造函数使用
+Request handle_request(Executor& executor, std::string /*logid*/, std::latch& done) {
+    auto data = timekeeper::ThreadDataManager::Instance().GetCurrentThreadData();
+    data->add_log_field("start_thread", thread_name());
+    {
+        timekeeper::CoroutineSpan span(co_await timekeeper::this_coroutine, "handle");
+        co_await ResumeOn{executor};
+        busy_for(std::chrono::milliseconds(2));
+        co_await fetch(executor, "fetch_user");
+        co_await fetch(executor, "fetch_items");
+        busy_for(std::chrono::milliseconds(2));
+    }
+    // 换过线程之后拿到的仍然是同一个请求
+    auto current = timekeeper::ThreadDataManager::Instance().GetCurrentThreadData();
+    current->add_log_field("end_thread", thread_name());
+    std::string report = current->report();
+    {
+        // 多个请求在不同的工作线程上结束，输出要串行化，否则会交错在一起
+        std::lock_guard lock(output_mutex);
+        std::cout << report << std::endl;
+    }
+    done.count_down();
+}
+
+}  // namespace
+
+int main() {
+    Executor executor(4);
+    const int requests = 3;
+    std::latch done(requests);
+    for (int i = 0; i < requests; ++i) {
+        handle_request(executor, "coroutine_request_" + std::to_string(i), done);
+    }
+    done.wait();
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <ucontext.h>
+
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "timekeeper/timekeeper.hpp"
+
+// M:N 调度下的存储策略
+// 用 ucontext 实现一个最小的协作式调度器，多个 fiber 在同一个线程上轮流执行：
+//   - 默认的 ThreadDataManager 用 thread_local，fiber 之间会互相覆盖 logid
+//   - SpecificStorage 把 TaskSlot 存在 fiber 自己的 specific 指针里，每个 fiber 拿到的都是自己的请求
+// bthread、boost.fiber 接入时把 get/set 换成 bthread_getspecific/setspecific 或 fiber_specific_ptr 即可
+
+namespace {
+
+class MiniScheduler {
+public:
+    struct Fiber {
+        ucontext_t context;
+        std::vector<char> stack;
+        std::function<void()> body;
+        void* specific = nullptr;   // 相当于 bthread 的 key 对应的值
+        bool done = false;
+    };
+
+    static MiniScheduler& Instance() {
+        static MiniScheduler scheduler;
+        return scheduler;
+    }
+
+    void spawn(std::function<void()> body) {
+        auto fiber = std::make_unique<Fiber>();
+        fiber->stack.resize(256 * 1024);
+        fiber->body = std::move(body);
+        getcontext(&fiber->context);
+        fiber->context.uc_stack.ss_sp = fiber->stack.data();
+        fiber->context.uc_stack.ss_size = fiber->stack.size();
+        fiber->context.uc_link = &_main;
+        makecontext(&fiber->context, &MiniScheduler::entry, 0);
+        _fibers.push_back(std::move(fiber));
+    }
+
+    // 轮流执行所有 fiber，直到全部结束；结束的 fiber 由调度器释放它的 specific，相当于 key 的析构回调
+    void run() {
+        bool remaining = true;
+        while (remaining) {
+            remaining = false;
+            for (auto& fiber : _fibers) {
+                if (fiber->done) {
+                    continue;
+                }
+                _current = fiber.get();
+                swapcontext(&_main, &fiber->context);
+                _current = nullptr;
+                if (fiber->done) {
+                    timekeeper::TaskSlot::Destroy(fiber->specific);
+                    fiber->specific = nullptr;
+                } else {
+                    remaining = true;
+                }
+            }
+        }
+        _fibers.clear();
+    }
+
+    void yield() {
+        swapcontext(&_current->context, &_main);
+    }
+
+    Fiber* current() const { return _current; }
+
+private:
+    static void entry() {
+        auto& scheduler = Instance();
+        scheduler._current->body();
+        scheduler._current->done = true;
+    }
+
+    ucontext_t _main;
+    std::vector<std::unique_ptr<Fiber>> _fibers;
+    Fiber* _current = nullptr;
+};
+
+void* get_fiber_slot() {
+    auto fiber = MiniScheduler::Instance().current();
+    return fiber ? fiber->specific : nullptr;
+}
+
+void set_fiber_slot(void* slot) {
+    MiniScheduler::Instance().current()->specific = slot;
+}
+
+using FiberDataManager = timekeeper::BasicThreadDataManager<timekeeper::SpecificStorage<get_fiber_slot, set_fiber_slot>>;
+
+// 每个 fiber 处理一个请求，每一步之后让出，恢复后检查拿到的是不是自己的请求
+template <typename Manager>
+void run_requests(const std::string& prefix, int& mismatches) {
+    auto& scheduler = MiniScheduler::Instance();
+    for (int i = 0; i < 3; ++i) {
+        scheduler.spawn([&scheduler, &mismatches, logid = prefix + std::to_string(i)] {
+            auto& manager = Manager::Instance();
+            auto data = manager.Init(logid);
+            auto guard = manager.GetKeyGuard();
+            for (int step = 0; step < 3; ++step) {
+                auto current = manager.GetCurrentThreadData();
+                auto timer = current->add_recorder("step" + std::to_string(step));
+                scheduler.yield();
+                if (manager.GetCurrentThreadData()->get_log_id() != logid) {
+                    ++mismatches;
+                }
+            }
+            std::cout << data->report() << std::endl;
+        });
+    }
+    scheduler.run();
+}
+
+}  // namespace
+
+int main() {
+    int thread_local_mismatches = 0;
+    std::cout << "== thread_local 存储 ==" << std::endl;
+    run_requests<timekeeper::ThreadDataManager>("thread_local_request_", thread_local_mismatches);
+
+    int fiber_mismatches = 0;
+    std::cout << std::endl << "== fiber specific 存储 ==" << std::endl;
+    run_requests<FiberDataManager>("fiber_request_", fiber_mismatches);
+
+    std::cout << std::endl << "上下文错乱次数，thread_local: " << thread_local_mismatches
+        << ", fiber specific: " << fiber_mismatches << std::endl;
+    return fiber_mismatches == 0 ? 0 : 1;
+}
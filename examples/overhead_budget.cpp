@@ -0,0 +1,68 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include "timekeeper/timekeeper.hpp"
+
+// 计时器自身开销统计和自适应降级
+// 请求很短、又打开了比较贵的探针时，开销占比会超过预算，Overhead 会逐级关闭探针和 SpanStats
+
+namespace {
+
+const char* level_name(timekeeper::Overhead::Level level) {
+    switch (level) {
+        case timekeeper::Overhead::Level::kFull: return "full";
+        case timekeeper::Overhead::Level::kNoProbes: return "no-probes";
+        case timekeeper::Overhead::Level::kMinimal: return "minimal";
+    }
+    return "unknown";
+}
+
+// 一个很短的请求：8 个 span，每个只做一点计算
+std::string handle(int i, bool print) {
+    timekeeper::ThreadData data("request_" + std::to_string(i));
+    data.set_probes(timekeeper::kProbeCpuTime | timekeeper::kProbeRusage);
+    volatile uint64_t sink = 0;
+    for (int step = 0; step < 8; ++step) {
+        auto timer = data.add_recorder("step" + std::to_string(step));
+        for (int k = 0; k < 200; ++k) {
+            sink = sink + k * step;
+        }
+    }
+    std::string report = data.report();
+    if (print) {
+        std::cout << report << std::endl;
+    }
+    return report;
+}
+
+void print_snapshot(const char* title) {
+    auto snapshot = timekeeper::Overhead::Instance().snapshot();
+    printf("%-12s requests: %llu overhead: %.3f(ms) request: %.3f(ms) ratio: %.2f%% level: %s\n",
+            title,
+            static_cast<unsigned long long>(snapshot.requests),
+            snapshot.overhead_ns / 1e6,
+            snapshot.request_ns / 1e6,
+            snapshot.ratio * 100,
+            level_name(snapshot.level));
+}
+
+}  // namespace
+
+int main() {
+    auto& overhead = timekeeper::Overhead::Instance();
+    overhead.set_enabled(true);
+    // 预算 1%，每 64 个请求结算一次
+    overhead.set_budget(0.01, 64);
+
+    handle(0, true);
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < 64; ++i) {
+            handle(i, false);
+        }
+        print_snapshot(("round " + std::to_string(round)).c_str());
+    }
+    // 降级后探针不再采集
+    handle(0, true);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "timekeeper/prometheus.hpp"
+#include "timekeeper/timekeeper.hpp"
+
+// 一个最简单的 HTTP 服务，代替真正的 metrics 端点，演示 PrometheusExporter
+//   prometheus_http [--port 9464] [--requests n] [--once]
+// --once 只渲染一次输出到 stdout；--requests n 处理 n 次抓取后退出
+
+namespace {
+
+void run_workload(std::atomic<bool>& stop) {
+    while (!stop.load()) {
+        timekeeper::ThreadData data("prometheus_demo");
+        auto handle = data.add_recorder("handle");
+        {
+            auto step = data.add_recorder("step1");
+            std::this_thread::sleep_for(std::chrono::microseconds(300));
+        }
+        handle->end();
+    }
+}
+
+void serve(int port, int requests, timekeeper::PrometheusExporter& exporter) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 16) != 0) {
+        std::cerr << "bind/listen failed, port: " << port << ", error: " << strerror(errno) << std::endl;
+        ::close(fd);
+        return;
+    }
+    std::cout << "serving http://127.0.0.1:" << port << "/metrics" << std::endl;
+
+    std::string response;
+    for (int i = 0; requests < 0 || i < requests; i++) {
+        int conn = ::accept(fd, nullptr, nullptr);
+        if (conn < 0) {
+            continue;
+        }
+        char request[1024];
+        ::recv(conn, request, sizeof(request), 0);  // 不解析请求，任何路径都返回 metrics
+
+        auto begin = std::chrono::steady_clock::now();
+        const std::string& body = exporter.render();
+        auto cost = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - begin).count();
+
+        response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+            + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+        response += body;
+        ::send(conn, response.data(), response.size(), MSG_NOSIGNAL);
+        ::close(conn);
+        std::cout << "scrape " << i << ": " << body.size() << " bytes, render " << cost << "us" << std::endl;
+    }
+    ::close(fd);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int port = 9464;
+    int requests = -1;
+    bool once = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+            requests = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--once") == 0) {
+            once = true;
+        }
+    }
+
+    timekeeper::ThreadDataManager::Instance().span_stats().set_enabled(true);
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 2; i++) {
+        workers.emplace_back(run_workload, std::ref(stop));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    timekeeper::PrometheusExporter exporter;
+    if (once) {
+        std::cout << exporter.render();
+    } else {
+        serve(port, requests, exporter);
+    }
+
+    stop = true;
+    for (auto& t : workers) {
+        t.join();
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "timekeeper/timekeeper.hpp"
+
+// 跨服务合并耗时：下游把自己的 span 编码后随响应返回，上游合并到自己的请求里，一份报告看到端到端的拆分
+// 这里用一个线程模拟下游服务，并故意让下游的时钟快 5 秒
+
+namespace {
+
+constexpr int64_t kRemoteClockSkewUs = 5 * 1000 * 1000;
+
+int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 下游服务处理一个请求，返回编码后的 span
+std::string downstream_handle() {
+    timekeeper::ThreadData data("downstream");
+    {
+        auto timer = data.add_recorder("query_db");
+        std::this_thread::sleep_for(std::chrono::milliseconds(3));
+    }
+    {
+        auto timer = data.add_recorder("render");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::string bytes = data.serialize_spans();
+
+    // 模拟时钟偏差：把编码结果里的时间整体平移
+    timekeeper::binary::Reader reader(bytes);
+    // 解析失败时返回空串，上游的 merge_remote 会报错；count 来自输入，不用它预分配
+    timekeeper::binary::SpansHeader header;
+    if (!timekeeper::binary::read_spans_header(reader, header)) {
+        std::cerr << "bad spans header" << std::endl;
+        return {};
+    }
+    std::vector<timekeeper::SpanRecord> spans;
+    for (uint64_t i = 0; i < header.count; ++i) {
+        timekeeper::SpanRecord span;
+        std::string_view name;
+        if (!timekeeper::binary::read_span(reader, header, name, span.start_us, span.end_us)) {
+            std::cerr << "bad span " << i << std::endl;
+            return {};
+        }
+        span.name = std::string(name);
+        span.start_us += kRemoteClockSkewUs;
+        span.end_us += kRemoteClockSkewUs;
+        spans.push_back(std::move(span));
+    }
+    std::string out;
+    timekeeper::binary::append_spans(out, spans, header.clock_us + kRemoteClockSkewUs);
+    return out;
+}
+
+}  // namespace
+
+int main() {
+    timekeeper::ThreadData data("upstream_request");
+    {
+        auto timer = data.add_recorder("parse");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::string response;
+    int64_t call_start_us, call_end_us;
+    {
+        auto timer = data.add_recorder("call_downstream");
+        call_start_us = now_us();
+        std::thread([&response] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));   // 请求的网络耗时
+            response = downstream_handle();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));   // 响应的网络耗时
+        }).join();
+        call_end_us = now_us();
+    }
+    std::cout << "downstream spans: " << response.size() << " bytes" << std::endl;
+
+    if (!data.merge_remote("downstream.", response, call_start_us, call_end_us)) {
+        std::cerr << "bad downstream spans" << std::endl;
+        return 1;
+    }
+    std::cout << data.report() << std::endl;
+
+    // 修正后下游的 span 应该落在 call_downstream 之内
+    for (auto& span : data.make_record().spans) {
+        if (span.name.rfind("downstream.", 0) == 0
+                && (span.start_us < call_start_us || span.end_us > call_end_us)) {
+            std::cerr << "span " << span.name << " outside of the call" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
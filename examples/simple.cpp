@@ -14,6 +14,9 @@ void process_request(const std::string& request_id) {
     // 添加日志字段
     guard->add_log_field("request_type", "standard");
     guard->add_log_field("priority", "high");
+    guard->add_log_field("retry_count", 0);
+    // 采集每个 span 的线程 CPU 时间和上下文切换，sleep 的部分会体现为 off-cpu 和自愿切换
+    guard->set_probes(timekeeper::kProbeCpuTime | timekeeper::kProbeRusage);
     
     // 创建一个时间记录器，用于记录处理时间
     auto main_timer = guard->add_recorder("main_process");
@@ -60,23 +63,23 @@ void process_request(const std::string& request_id) {
 }
 
 // 模拟子线程函数，继承父线程的上下文
-void sub_task(const std::string& parent_request_id, const std::string& subtask_id) {
-    // 初始化子任务的线程数据，基于父请求
-    auto subtask_guard = timekeeper::ThreadDataManager::Instance().Init(subtask_id);
+// 子线程挂上父请求的 Context 后，记录和字段都计入父请求
+void sub_task(timekeeper::Context context, const std::string& subtask_id) {
+    timekeeper::ContextScope scope(context);
+    auto data = timekeeper::ThreadDataManager::Instance().GetCurrentThreadData();
     
-    std::cout << "开始子任务: " << subtask_id << "（父请求: " << parent_request_id << "）" << std::endl;
+    std::cout << "开始子任务: " << subtask_id << "（父请求: " << data->get_log_id() << "）" << std::endl;
     
     // 添加子任务特定字段
-    subtask_guard->add_log_field("subtask_type", "async");
+    data->add_log_field(subtask_id + "_type", "async");
     
     // 记录子任务时间
-    auto subtask_timer = subtask_guard->add_recorder("subtask_execution");
+    auto subtask_timer = data->add_recorder(subtask_id + "_execution");
     
     // 模拟子任务处理
     std::this_thread::sleep_for(std::chrono::milliseconds(200));
     
-    std::cout << "子任务完成，详细信息: " << std::endl;
-    std::cout << subtask_guard->report() << std::endl;
+    std::cout << "子任务完成: " << subtask_id << std::endl;
 }
 
 // 演示多个并发请求
@@ -103,12 +106,18 @@ void demonstrate_nested_context() {
     
     std::cout << "启动主请求: " << main_request_id << std::endl;
     
-    // 启动几个子任务线程
+    // 启动几个子任务线程，把当前请求的上下文带过去
+    auto context = timekeeper::ThreadDataManager::Instance().Capture();
     std::vector<std::thread> subtasks;
     for (int i = 1; i <= 2; i++) {
         std::string subtask_id = "subtask_" + std::to_string(i);
-        subtasks.emplace_back(sub_task, main_request_id, subtask_id);
+        subtasks.emplace_back(sub_task, context, subtask_id);
     }
+    // 也可以用 with_context 包装任务
+    subtasks.emplace_back(timekeeper::with_context(context, [] {
+        auto timer = timekeeper::ThreadDataManager::Instance().GetCurrentThreadData()->add_recorder("wrapped_task");
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }));
     
     // 等待所有子任务完成
     for (auto& t : subtasks) {
@@ -119,6 +128,43 @@ void demonstrate_nested_context() {
     std::cout << main_guard->report() << std::endl;
 }
 
+// 演示异步输出：请求线程只入队，格式化和写 stdout 在后台线程完成
+void demonstrate_async_emit() {
+    std::vector<std::thread> threads;
+    for (int i = 1; i <= 3; i++) {
+        threads.emplace_back([i] {
+            auto guard = timekeeper::ThreadDataManager::Instance().Init("async_request_" + std::to_string(i));
+            guard->add_log_field("attempt", i);
+            {
+                auto timer = guard->add_recorder("handle");
+                std::this_thread::sleep_for(std::chrono::milliseconds(20 * i));
+            }
+            guard->emit_async();
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    auto& emitter = timekeeper::AsyncEmitter::Instance();
+    emitter.flush();
+    std::cout << "异步输出完成，written: " << emitter.written()
+        << ", dropped: " << emitter.dropped() << std::endl;
+}
+
+// 演示批量写入字段：整批只加一次锁
+void demonstrate_batch_fields() {
+    timekeeper::ThreadData data("batch_request");
+    std::vector<std::pair<std::string, timekeeper::LogValue>> fields = {
+        {"method", "GET"},
+        {"n", 3},
+        {"bytes", 512u},
+        {"cached", false},
+    };
+    data.add_log_fields(fields);
+    std::cout << data.report() << std::endl;
+}
+
 int main() {
     std::cout << "====== 演示 TimeKeeper 库的基本功能 ======" << std::endl << std::endl;
     
@@ -132,6 +178,14 @@ int main() {
     
     std::cout << "== 嵌套上下文示例 ==" << std::endl;
     demonstrate_nested_context();
+    std::cout << std::endl;
+
+    std::cout << "== 异步输出示例 ==" << std::endl;
+    demonstrate_async_emit();
+    std::cout << std::endl;
+
+    std::cout << "== 批量写入字段示例 ==" << std::endl;
+    demonstrate_batch_fields();
     
     return 0;
 }
@@ -0,0 +1,35 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "timekeeper/timekeeper.hpp"
+
+// 长请求的周期性输出：流式 RPC 持续很久，report() 会结束所有记录，只能在最后调用一次
+// snapshot() 不结束记录，未结束的记录标记为 running；增量快照只输出上一次增量快照之后完成的记录
+
+int main() {
+    timekeeper::ThreadData data("stream_request");
+    data.add_log_field("method", "Subscribe");
+
+    auto whole = data.add_recorder("stream");
+    {
+        auto timer = data.add_recorder("handshake");
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    for (int batch = 0; batch < 3; ++batch) {
+        {
+            auto timer = data.add_recorder("send_batch_" + std::to_string(batch));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        {
+            auto timer = data.add_recorder("encode");
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::cout << "incremental: " << data.snapshot(true) << std::endl;
+    }
+
+    std::cout << "full:        " << data.snapshot() << std::endl;
+    std::cout << "report:      " << data.report() << std::endl;
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "timekeeper/timekeeper.hpp"
+
+// 并发压力：大量线程往同一个请求里建立、结束记录，同时有线程不停地 report / snapshot
+// 记录有的自己结束，有的交给别的线程结束，有的被 report 强制结束
+// 用 -DTIMEKEEPER_TSAN=ON 构建后运行，检查数据竞争和死锁：
+//   stress_report [threads] [iterations]
+
+namespace {
+
+constexpr int kNames = 8;
+
+// 线程之间交换记录，让记录在别的线程结束
+class Exchange {
+public:
+    std::shared_ptr<timekeeper::TimeRecorder> swap(std::shared_ptr<timekeeper::TimeRecorder> recorder) {
+        std::lock_guard lock(_mtx);
+        std::swap(_slot, recorder);
+        return recorder;
+    }
+
+private:
+    std::mutex _mtx;
+    std::shared_ptr<timekeeper::TimeRecorder> _slot;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int threads = argc > 1 ? std::atoi(argv[1]) : 64;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    timekeeper::ThreadData data("stress");
+    Exchange exchange;
+    std::atomic<bool> stop{false};
+    std::atomic<int64_t> reports{0};
+
+    std::vector<std::thread> reporters;
+    for (int i = 0; i < 4; ++i) {
+        reporters.emplace_back([&, i] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                switch (i) {
+                    case 0: data.report(); break;
+                    case 1: data.snapshot(); break;
+                    case 2: data.snapshot(true); break;
+                    default: data.make_record(); break;
+                }
+                reports.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < iterations; ++i) {
+                auto recorder = data.add_recorder("step_" + std::to_string((t + i) % kNames));
+                switch (i % 4) {
+                    case 0:
+                        recorder->end();
+                        break;
+                    case 1:
+                        // 交给别的线程结束
+                        recorder = exchange.swap(std::move(recorder));
+                        break;
+                    case 2:
+                        recorder->start();
+                        recorder->get_time_from_start();
+                        break;
+                    default:
+                        data.add_log_field("worker_" + std::to_string(t), i, true);
+                        break;
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    exchange.swap(nullptr);
+    stop.store(true);
+    for (auto& reporter : reporters) {
+        reporter.join();
+    }
+
+    // 每个名字都应该出现在最终的报告里
+    auto record = data.make_record();
+    int missing = kNames;
+    for (auto& span : record.spans) {
+        if (span.name.rfind("step_", 0) == 0) {
+            --missing;
+        }
+    }
+    std::cout << "threads: " << threads << " iterations: " << iterations
+        << " reports: " << reports.load() << " spans: " << record.spans.size()
+        << " fields: " << record.fields.size() << std::endl;
+    if (missing != 0 || (iterations >= 4 && static_cast<int>(record.fields.size()) != threads)) {
+        std::cerr << "unexpected final record" << std::endl;
+        return 1;
+    }
+    return 0;
+}
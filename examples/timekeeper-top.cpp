@@ -0,0 +1,121 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "timekeeper/shm_stats.hpp"
+#include "timekeeper/timekeeper.hpp"
+
+// 挂载 ShmStatsPublisher 发布的共享内存段，定期刷新显示每个 span 的统计
+//   timekeeper-top [--name /timekeeper_stats] [--interval ms] [--iterations n] [--demo]
+// --demo 会在本进程里启动一个模拟负载并发布统计，方便单独演示
+
+namespace {
+
+void run_demo_workload(std::atomic<bool>& stop) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> jitter(0, 3000);
+    while (!stop.load()) {
+        timekeeper::ThreadData data("demo");
+        {
+            auto handle = data.add_recorder("handle");
+            {
+                auto db = data.add_recorder("db_query");
+                std::this_thread::sleep_for(std::chrono::microseconds(500 + jitter(rng)));
+            }
+            auto render = data.add_recorder("render");
+            std::this_thread::sleep_for(std::chrono::microseconds(200 + jitter(rng) / 10));
+        }
+    }
+}
+
+void print_table(const timekeeper::ShmStatsReader::Snapshot& snapshot,
+        std::map<std::string, uint64_t>& last_counts, double interval_s) {
+    printf("\033[2J\033[H");
+    printf("pid: %lld  spans: %zu  dropped: %llu\n\n",
+            static_cast<long long>(snapshot.pid), snapshot.slots.size(),
+            static_cast<unsigned long long>(snapshot.dropped));
+    printf("%-32s %12s %10s %10s %10s %10s %10s\n",
+            "NAME", "COUNT", "QPS", "AVG(ms)", "P50(ms)", "P99(ms)", "MAX(ms)");
+    for (auto& slot : snapshot.slots) {
+        std::string name(slot.name, strnlen(slot.name, sizeof(slot.name)));
+        uint64_t last = last_counts[name];
+        double qps = interval_s > 0 ? (slot.count - last) / interval_s : 0;
+        last_counts[name] = slot.count;
+        double avg = slot.count ? slot.sum_us / 1000.0 / slot.count : 0;
+        printf("%-32s %12llu %10.1f %10.3f %10.3f %10.3f %10.3f\n",
+                name.c_str(), static_cast<unsigned long long>(slot.count), qps, avg,
+                timekeeper::estimate_quantile(slot.buckets, 0.5, slot.max_us) / 1000.0,
+                timekeeper::estimate_quantile(slot.buckets, 0.99, slot.max_us) / 1000.0,
+                slot.max_us / 1000.0);
+    }
+    fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string name = "/timekeeper_stats";
+    int interval_ms = 1000;
+    int iterations = -1;
+    bool demo = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            name = argv[++i];
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval_ms = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--demo") == 0) {
+            demo = true;
+        } else {
+            std::cerr << "usage: " << argv[0]
+                << " [--name /timekeeper_stats] [--interval ms] [--iterations n] [--demo]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::unique_ptr<timekeeper::ShmStatsPublisher> publisher;
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> workers;
+    if (demo) {
+        timekeeper::ThreadDataManager::Instance().span_stats().set_enabled(true);
+        publisher = std::make_unique<timekeeper::ShmStatsPublisher>(name);
+        publisher->start(std::chrono::milliseconds(interval_ms / 2 > 0 ? interval_ms / 2 : 1));
+        for (int i = 0; i < 4; i++) {
+            workers.emplace_back(run_demo_workload, std::ref(stop));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    }
+
+    timekeeper::ShmStatsReader reader(name);
+    if (!reader.ok()) {
+        std::cerr << "cannot attach shm segment: " << name << std::endl;
+        return 1;
+    }
+
+    std::map<std::string, uint64_t> last_counts;
+    timekeeper::ShmStatsReader::Snapshot snapshot;
+    auto last = std::chrono::steady_clock::now();
+    for (int i = 0; iterations < 0 || i < iterations; i++) {
+        auto now = std::chrono::steady_clock::now();
+        double interval_s = i == 0 ? 0 : std::chrono::duration<double>(now - last).count();
+        last = now;
+        if (reader.read(snapshot)) {
+            print_table(snapshot, last_counts, interval_s);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    }
+
+    stop = true;
+    for (auto& t : workers) {
+        t.join();
+    }
+    return 0;
+}
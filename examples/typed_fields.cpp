@@ -0,0 +1,52 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include "timekeeper/timekeeper.hpp"
+
+// 带类型的日志字段：数值和布尔值直接存储，report 时才格式化
+// 字符串字面量按字符串存储（不会退化成 bool），有符号整数存为 kInt，无符号整数存为 kUint
+
+using timekeeper::LogValue;
+
+bool check(const char* what, const LogValue& value, LogValue::Type type, const std::string& text) {
+    if (value.type() != type || value.to_string() != text) {
+        std::cerr << what << " 的类型或取值不对，实际为 " << value.to_string() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    timekeeper::ThreadData data("typed_fields");
+    data.add_log_field("method", "GET");
+    data.add_log_field("path", std::string("/index"));
+    data.add_log_field("retry", 3);
+    data.add_log_field("bytes", 512u);
+    data.add_log_field("offset", uint64_t(UINT64_MAX));
+    data.add_log_field("ratio", 0.25);
+    data.add_log_field("cached", false);
+    std::cout << data.report() << std::endl;
+
+    bool ok = true;
+    for (auto& [key, value] : data.make_snapshot().fields) {
+        if (key == "method") {
+            ok &= check("method", value, LogValue::Type::kString, "GET");
+        } else if (key == "path") {
+            ok &= check("path", value, LogValue::Type::kString, "/index");
+        } else if (key == "retry") {
+            ok &= check("retry", value, LogValue::Type::kInt, "3");
+        } else if (key == "bytes") {
+            ok &= check("bytes", value, LogValue::Type::kUint, "512");
+        } else if (key == "offset") {
+            ok &= check("offset", value, LogValue::Type::kUint, "18446744073709551615");
+        } else if (key == "ratio") {
+            ok &= check("ratio", value, LogValue::Type::kDouble, "0.25");
+        } else if (key == "cached") {
+            ok &= check("cached", value, LogValue::Type::kBool, "false");
+        }
+    }
+    // 直接构造 LogValue 时规则相同
+    ok &= check("LogValue(\"GET\")", LogValue("GET"), LogValue::Type::kString, "GET");
+    ok &= check("LogValue(-5)", LogValue(-5), LogValue::Type::kInt, "-5");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "timekeeper/record.hpp"
+
+namespace timekeeper {
+
+// 堆分配统计：把分配的字节数和次数记到当前线程最内层的、打开了 kProbeAlloc 的 TimeRecorder 上
+//
+// 统计本身只是头文件里的线程局部计数，真正的 operator new/delete 替换在 src/alloc_hooks.cpp，
+// 需要额外链接 timekeeper_alloc 目标才会生效；没有链接时 hooks_installed() 为 false，探针不产生数据
+namespace alloc {
+
+constexpr int kMaxDepth = 64;
+
+// 每个线程一个分配栈，栈顶是最内层的活跃记录
+// 计数只由所属线程写；字段用 relaxed 原子变量，是为了别的线程结束记录时读取不构成数据竞争，
+// 在 x86 上 load + store 编译成普通的 mov，不是加锁的 RMW
+struct Frame {
+    std::atomic<int64_t> bytes{0};
+    std::atomic<int64_t> count{0};
+    std::atomic<bool> closed{false};
+    uint64_t generation = 0;
+};
+
+struct Stack {
+    Frame frames[kMaxDepth];
+    int depth = 0;          // 只由所属线程读写
+    uint64_t generation = 0;
+
+    // 弹出栈顶已经结束的记录（包括在别的线程结束的）
+    void pop_closed() {
+        while (depth > 0 && frames[depth - 1].closed.load(std::memory_order_acquire)) {
+            --depth;
+        }
+    }
+};
+
+inline std::atomic<bool>& hooks_installed_flag() {
+    static std::atomic<bool> flag{false};
+    return flag;
+}
+
+inline bool hooks_installed() {
+    return hooks_installed_flag().load(std::memory_order_relaxed);
+}
+
+// 分配钩子读取的指针，普通指针没有 thread_local 的初始化检查，钩子里不会触发分配
+inline thread_local Stack* tls_stack = nullptr;
+
+// 持有当前线程的 Stack；记录可能在别的线程结束，所以用 shared_ptr 保证 Stack 活得足够久
+inline std::shared_ptr<Stack>& thread_stack() {
+    static thread_local struct Holder {
+        std::shared_ptr<Stack> stack;
+        ~Holder() { tls_stack = nullptr; }
+    } holder;
+    if (!holder.stack) {
+        holder.stack = std::make_shared<Stack>();
+        tls_stack = holder.stack.get();
+    }
+    return holder.stack;
+}
+
+// 非零时不计数，timekeeper 自己的分配（注册记录、探针状态、上传合并等）不算到用户的 span 上
+// 常量初始化的 thread_local，钩子里读取没有初始化检查
+inline thread_local int tls_suppress = 0;
+
+// 作用域内当前线程的分配不计入任何记录，可以嵌套
+class SuppressScope {
+public:
+    SuppressScope() { ++tls_suppress; }
+    ~SuppressScope() { --tls_suppress; }
+
+    SuppressScope(const SuppressScope &) = delete;
+    SuppressScope& operator=(const SuppressScope &) = delete;
+};
+
+// 由替换的 operator new 调用
+inline void on_alloc(size_t size) {
+    Stack* stack = tls_stack;
+    if (!stack || stack->depth == 0 || tls_suppress) {
+        return;
+    }
+    Frame& frame = stack->frames[stack->depth - 1];
+    frame.bytes.store(frame.bytes.load(std::memory_order_relaxed) + static_cast<int64_t>(size),
+            std::memory_order_relaxed);
+    frame.count.store(frame.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+}  // namespace alloc
+
+// 一条记录对应的分配栈帧，begin 入栈，end 出栈并把计数写入 metrics
+class AllocScope {
+public:
+    AllocScope() = default;
+    AllocScope(const AllocScope &) = delete;
+    AllocScope& operator=(const AllocScope &) = delete;
+
+    ~AllocScope() {
+        close();
+    }
+
+    // 重复调用（构造后又 start）时只清零计数
+    void begin() {
+        if (!alloc::hooks_installed()) {
+            return;
+        }
+        if (_stack) {
+            alloc::Frame& frame = _stack->frames[_index];
+            if (_stack.get() == alloc::tls_stack && frame.generation == _generation) {
+                frame.bytes.store(0, std::memory_order_relaxed);
+                frame.count.store(0, std::memory_order_relaxed);
+                return;
+            }
+            close();
+        }
+        auto& stack = alloc::thread_stack();
+        stack->pop_closed();
+        if (stack->depth >= alloc::kMaxDepth) {
+            return;
+        }
+        _index = stack->depth++;
+        alloc::Frame& frame = stack->frames[_index];
+        frame.bytes.store(0, std::memory_order_relaxed);
+        frame.count.store(0, std::memory_order_relaxed);
+        frame.closed.store(false, std::memory_order_relaxed);
+        frame.generation = _generation = ++stack->generation;
+        _stack = stack;
+    }
+
+    // 只统计自己这一层（不含子记录）的分配
+    void end(SpanMetrics& metrics) {
+        if (!_stack) {
+            return;
+        }
+        alloc::Frame& frame = _stack->frames[_index];
+        metrics.alloc_bytes = frame.bytes.load(std::memory_order_relaxed);
+        metrics.alloc_count = frame.count.load(std::memory_order_relaxed);
+        close();
+    }
+
+private:
+    void close() {
+        if (!_stack) {
+            return;
+        }
+        _stack->frames[_index].closed.store(true, std::memory_order_release);
+        if (_stack.get() == alloc::tls_stack) {
+            _stack->pop_closed();
+        }
+        _stack.reset();
+    }
+
+    std::shared_ptr<alloc::Stack> _stack;
+    int _index = 0;
+    uint64_t _generation = 0;
+};
+
+}
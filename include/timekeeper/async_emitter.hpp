@@ -0,0 +1,258 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "timekeeper/record.hpp"
+#include "timekeeper/sink.hpp"
+
+namespace timekeeper {
+
+// 有界 MPMC 环形队列（Vyukov），这里只有一个消费者
+// 每个槽位带一个序号，生产者之间只在 _tail 上做 CAS，不需要锁
+template <typename T>
+class BoundedQueue {
+public:
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue& operator=(const BoundedQueue &) = delete;
+
+    // capacity 会向上取整到 2 的幂
+    explicit BoundedQueue(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) {
+            n <<= 1;
+        }
+        _mask = n - 1;
+        _cells = std::make_unique<Cell[]>(n);
+        for (size_t i = 0; i < n; ++i) {
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(T&& value) {
+        size_t pos = _tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = _cells[pos & _mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // 队列满
+            } else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T& value) {
+        size_t pos = _head.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = _cells[pos & _mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.seq.store(pos + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // 队列空
+            } else {
+                pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t capacity() const { return _mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> _cells;
+    size_t _mask;
+    alignas(64) std::atomic<size_t> _tail{0};
+    alignas(64) std::atomic<size_t> _head{0};
+};
+
+// 异步输出：请求线程只把 RequestRecord 放进队列，后台线程批量格式化并写出
+class AsyncEmitter {
+public:
+    // 队列满时的策略
+    enum class OverflowPolicy {
+        kDrop,   // 直接丢弃，计入 dropped
+        kBlock,  // 等待后台线程腾出空间
+    };
+
+    struct Options {
+        size_t capacity = 4096;                             // 队列长度
+        size_t batch_size = 256;                            // 每批最多格式化多少条
+        OverflowPolicy policy = OverflowPolicy::kDrop;
+        std::chrono::milliseconds flush_interval{100};      // 队列空闲时的唤醒间隔
+        std::shared_ptr<RecordFormatter> formatter;         // 为空时使用 TextFormatter
+    };
+
+    // 一批格式化好的数据
+    using Writer = std::function<void(const std::string& batch)>;
+
+    // disable copy, assignment, move
+    AsyncEmitter(const AsyncEmitter &) = delete;
+    AsyncEmitter& operator=(const AsyncEmitter &) = delete;
+    AsyncEmitter(AsyncEmitter &&) = delete;
+
+    explicit AsyncEmitter(Writer writer) : AsyncEmitter(std::move(writer), Options()) {}
+
+    // 写到 Sink，空闲时会调用 sink->poll() 触发按时间的刷盘，析构时调用 sink->flush()
+    explicit AsyncEmitter(std::shared_ptr<Sink> sink) : AsyncEmitter(std::move(sink), Options()) {}
+
+    AsyncEmitter(std::shared_ptr<Sink> sink, Options options)
+        : AsyncEmitter([sink](const std::string& batch) { sink->write(batch); }, sink, options) {}
+
+    AsyncEmitter(Writer writer, Options options) : AsyncEmitter(std::move(writer), nullptr, options) {}
+
+    // 析构时会把队列里剩余的记录写完
+    ~AsyncEmitter() {
+        {
+            std::lock_guard lock(_mtx);
+            _stop = true;
+        }
+        _cv.notify_one();
+        _thread.join();
+    }
+
+    // 默认实例，输出到 stdout
+    static AsyncEmitter& Instance() {
+        static AsyncEmitter instance(std::make_shared<StreamSink>(stdout));
+        return instance;
+    }
+
+    bool push(RequestRecord&& record) {
+        while (!_queue.try_push(std::move(record))) {
+            if (_options.policy == OverflowPolicy::kDrop) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            wake();
+            std::this_thread::yield();
+        }
+        // 和 run() 里睡眠前的检查配对，见 run()
+        _pushed.fetch_add(1, std::memory_order_seq_cst);
+        wake();
+        return true;
+    }
+
+    // 等待当前已入队的记录全部写出
+    void flush() {
+        uint64_t target = _pushed.load(std::memory_order_acquire);
+        std::unique_lock lock(_mtx);
+        _sleeping.store(false, std::memory_order_relaxed);
+        _cv.notify_one();
+        _flushed_cv.wait(lock, [&] {
+            return _written.load(std::memory_order_acquire) >= target;
+        });
+    }
+
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+    uint64_t written() const { return _written.load(std::memory_order_relaxed); }
+
+private:
+    AsyncEmitter(Writer writer, std::shared_ptr<Sink> sink, Options options)
+        : _writer(std::move(writer)), _sink(std::move(sink)), _options(options), _queue(options.capacity) {
+        if (!_options.formatter) {
+            _options.formatter = std::make_shared<TextFormatter>();
+        }
+        _thread = std::thread([this] { run(); });
+    }
+
+    // 只有后台线程睡眠时才需要加锁通知，热路径上只是一次原子读
+    void wake() {
+        if (_sleeping.load(std::memory_order_seq_cst)) {
+            std::lock_guard lock(_mtx);
+            _sleeping.store(false, std::memory_order_relaxed);
+            _cv.notify_one();
+        }
+    }
+
+    void run() {
+        std::string buffer;
+        RequestRecord record;
+        bool stopping = false;
+        for (;;) {
+            size_t n = 0;
+            buffer.clear();
+            while (n < _options.batch_size && _queue.try_pop(record)) {
+                if (n == 0) {
+                    _options.formatter->begin_batch(buffer);
+                }
+                _options.formatter->append(buffer, record);
+                ++n;
+            }
+            if (n > 0) {
+                _options.formatter->end_batch(buffer);
+                _writer(buffer);
+                _written.fetch_add(n, std::memory_order_release);
+                std::lock_guard lock(_mtx);
+                _flushed_cv.notify_all();
+                continue;
+            }
+            if (stopping) {
+                break;
+            }
+            if (_sink) {
+                _sink->poll();
+            }
+
+            std::unique_lock lock(_mtx);
+            if (_stop) {
+                // 收到停止信号后再排空一轮队列
+                stopping = true;
+                continue;
+            }
+            // 置位之后再看一次有没有新入队的记录，否则 try_pop 失败之后入队、又没看到 _sleeping 的生产者不会通知，
+            // 记录要白等一个 flush_interval。这里先写 _sleeping 再读 _pushed，push 先写 _pushed 再读 _sleeping，
+            // 都用 seq_cst，两边至少有一边能看到对方
+            _sleeping.store(true, std::memory_order_seq_cst);
+            if (_pushed.load(std::memory_order_seq_cst) == _written.load(std::memory_order_relaxed)) {
+                _cv.wait_for(lock, _options.flush_interval);
+            }
+            _sleeping.store(false, std::memory_order_relaxed);
+        }
+        if (_sink) {
+            _sink->flush();
+        }
+    }
+
+    Writer _writer;
+    std::shared_ptr<Sink> _sink;
+    Options _options;
+    BoundedQueue<RequestRecord> _queue;
+
+    std::atomic<uint64_t> _pushed{0};
+    std::atomic<uint64_t> _written{0};
+    std::atomic<uint64_t> _dropped{0};
+
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    std::condition_variable _flushed_cv;
+    std::atomic<bool> _sleeping{false};
+    bool _stop = false;
+    std::thread _thread;
+};
+
+}
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "timekeeper/record.hpp"
+#include "timekeeper/sink.hpp"
+
+namespace timekeeper {
+
+// 二进制记录格式，每条记录自描述，可以直接拼接/追加/切分文件：
+//
+//   record  := magic(2B "TK") version(1B) varint(payload_len) payload
+//   payload := string(logid) svarint(base_us)
+//              varint(n_fields) field*
+//              varint(n_spans) span*
+//   field   := string(key) type(1B) value                    -- int: svarint, uint: varint, double: 8B LE, bool: 1B, string: string
+//   span    := string(name) flags(1B) varint(start_us - base_us) varint(end_us - start_us) metrics
+//   flags   := bit0 in_progress
+//   metrics := varint(mask) svarint(value)*                  -- mask 的第 i 位对应 kMetricFields[i]，只写和默认值不同的指标
+//   string  := varint(len) bytes
+//
+// base_us 取所有 span 的最小开始时间，时间戳都是相对它的差值，通常 1~3 字节
+// 一条记录里的 span 已按名字合并、名字互不相同，名字直接内联；不做跨记录的字典，保证每条记录都能单独解码
+namespace binary {
+
+constexpr char kMagic[2] = {'T', 'K'};
+constexpr uint8_t kVersion = 2;
+
+constexpr uint8_t kSpanInProgress = 1;
+
+// 编码的 SpanMetrics 字段，顺序即 metrics 掩码的位，只能在末尾追加
+constexpr int64_t SpanMetrics::* kMetricFields[] = {
+    &SpanMetrics::cpu_us, &SpanMetrics::cpu_wall_us,
+    &SpanMetrics::cycles, &SpanMetrics::instructions, &SpanMetrics::cache_misses, &SpanMetrics::branch_misses,
+    &SpanMetrics::voluntary_switches, &SpanMetrics::involuntary_switches,
+    &SpanMetrics::minor_faults, &SpanMetrics::major_faults,
+    &SpanMetrics::alloc_bytes, &SpanMetrics::alloc_count,
+    &SpanMetrics::active_us, &SpanMetrics::active_wall_us,
+};
+constexpr size_t kMetricCount = sizeof(kMetricFields) / sizeof(kMetricFields[0]);
+
+inline void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out += static_cast<char>(v | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+inline void put_svarint(std::string& out, int64_t v) {
+    put_varint(out, (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+}
+
+inline void put_string(std::string& out, std::string_view s) {
+    put_varint(out, s.size());
+    out.append(s.data(), s.size());
+}
+
+inline void put_fixed64(std::string& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+        out += static_cast<char>(v >> (i * 8));
+    }
+}
+
+// 顺序读取，任何越界都会把 ok() 置为 false，之后的读取都返回 0/空
+// 读出的 string_view 直接指向输入，不拷贝
+class Reader {
+public:
+    explicit Reader(std::string_view data) : _p(data.data()), _end(data.data() + data.size()) {}
+
+    bool ok() const { return _ok; }
+    bool eof() const { return _p >= _end; }
+    size_t remaining() const { return _end - _p; }
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (_p >= _end) {
+                return fail();
+            }
+            uint8_t b = static_cast<uint8_t>(*_p++);
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return v;
+            }
+        }
+        return fail();
+    }
+
+    int64_t svarint() {
+        uint64_t v = varint();
+        return static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1));
+    }
+
+    uint8_t byte() {
+        if (_p >= _end) {
+            return static_cast<uint8_t>(fail());
+        }
+        return static_cast<uint8_t>(*_p++);
+    }
+
+    uint64_t fixed64() {
+        if (remaining() < 8) {
+            return fail();
+        }
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i) {
+            v |= static_cast<uint64_t>(static_cast<uint8_t>(_p[i])) << (i * 8);
+        }
+        _p += 8;
+        return v;
+    }
+
+    std::string_view bytes(size_t n) {
+        if (remaining() < n) {
+            fail();
+            return {};
+        }
+        std::string_view s(_p, n);
+        _p += n;
+        return s;
+    }
+
+    std::string_view string() {
+        return bytes(varint());
+    }
+
+private:
+    uint64_t fail() {
+        _ok = false;
+        _p = _end;
+        return 0;
+    }
+
+    const char* _p;
+    const char* _end;
+    bool _ok = true;
+};
+
+inline void put_metrics(std::string& out, const SpanMetrics& metrics) {
+    const SpanMetrics defaults;
+    uint64_t mask = 0;
+    for (size_t i = 0; i < kMetricCount; ++i) {
+        if (metrics.*kMetricFields[i] != defaults.*kMetricFields[i]) {
+            mask |= uint64_t(1) << i;
+        }
+    }
+    put_varint(out, mask);
+    for (size_t i = 0; i < kMetricCount; ++i) {
+        if (mask & (uint64_t(1) << i)) {
+            put_svarint(out, metrics.*kMetricFields[i]);
+        }
+    }
+}
+
+// 掩码里有未知的位时返回 false
+inline bool read_metrics(Reader& reader, SpanMetrics& metrics) {
+    uint64_t mask = reader.varint();
+    if (mask >> kMetricCount) {
+        return false;
+    }
+    for (size_t i = 0; i < kMetricCount; ++i) {
+        if (mask & (uint64_t(1) << i)) {
+            metrics.*kMetricFields[i] = reader.svarint();
+        }
+    }
+    return reader.ok();
+}
+
+// 编码一条记录，追加到 out
+inline void append_record(std::string& out, const RequestRecord& record) {
+    int64_t base_us = 0;
+    if (!record.spans.empty()) {
+        base_us = record.spans[0].start_us;
+        for (auto& span : record.spans) {
+            base_us = std::min(base_us, span.start_us);
+        }
+    }
+
+    // 先写 payload，再回填长度；payload 直接写在 out 的尾部，避免额外的缓冲区
+    out.append(kMagic, 2);
+    out += static_cast<char>(kVersion);
+    size_t payload_pos = out.size();
+
+    put_string(out, record.logid);
+    put_svarint(out, base_us);
+
+    put_varint(out, record.fields.size());
+    for (auto& field : record.fields) {
+        put_string(out, field.first);
+        const LogValue& value = field.second;
+        out += static_cast<char>(value.type());
+        switch (value.type()) {
+            case LogValue::Type::kString:
+                put_string(out, value.as_string());
+                break;
+            case LogValue::Type::kInt:
+                put_svarint(out, value.as_int());
+                break;
+            case LogValue::Type::kUint:
+                put_varint(out, value.as_uint());
+                break;
+            case LogValue::Type::kDouble: {
+                uint64_t bits;
+                double d = value.as_double();
+                memcpy(&bits, &d, sizeof(bits));
+                put_fixed64(out, bits);
+                break;
+            }
+            case LogValue::Type::kBool:
+                out += static_cast<char>(value.as_bool() ? 1 : 0);
+                break;
+        }
+    }
+
+    put_varint(out, record.spans.size());
+    for (auto& span : record.spans) {
+        put_string(out, span.name);
+        out += static_cast<char>(span.in_progress ? kSpanInProgress : 0);
+        put_varint(out, static_cast<uint64_t>(span.start_us - base_us));
+        put_varint(out, static_cast<uint64_t>(std::max<int64_t>(span.end_us - span.start_us, 0)));
+        put_metrics(out, span.metrics);
+    }
+
+    // 回填 payload 长度
+    std::string len;
+    put_varint(len, out.size() - payload_pos);
+    out.insert(payload_pos, len);
+}
+
+// 解码一条记录，失败返回 false（数据截断、magic 或版本不匹配）
+inline bool read_record(Reader& reader, RequestRecord& record) {
+    std::string_view magic = reader.bytes(2);
+    if (!reader.ok() || magic[0] != kMagic[0] || magic[1] != kMagic[1]) {
+        return false;
+    }
+    if (reader.byte() != kVersion) {
+        return false;
+    }
+    Reader payload(reader.string());
+    if (!reader.ok()) {
+        return false;
+    }
+
+    record.logid = std::string(payload.string());
+    int64_t base_us = payload.svarint();
+
+    record.fields.clear();
+    uint64_t n_fields = payload.varint();
+    for (uint64_t i = 0; i < n_fields && payload.ok(); ++i) {
+        std::string key(payload.string());
+        auto type = static_cast<LogValue::Type>(payload.byte());
+        switch (type) {
+            case LogValue::Type::kString:
+                record.fields.emplace_back(std::move(key), LogValue(payload.string()));
+                break;
+            case LogValue::Type::kInt:
+                record.fields.emplace_back(std::move(key), LogValue(payload.svarint()));
+                break;
+            case LogValue::Type::kUint:
+                record.fields.emplace_back(std::move(key), LogValue(payload.varint()));
+                break;
+            case LogValue::Type::kDouble: {
+                uint64_t bits = payload.fixed64();
+                double d;
+                memcpy(&d, &bits, sizeof(d));
+                record.fields.emplace_back(std::move(key), LogValue(d));
+                break;
+            }
+            case LogValue::Type::kBool:
+                record.fields.emplace_back(std::move(key), LogValue(payload.byte() != 0));
+                break;
+            default:
+                return false;
+        }
+    }
+
+    record.spans.clear();
+    uint64_t n_spans = payload.varint();
+    for (uint64_t i = 0; i < n_spans && payload.ok(); ++i) {
+        SpanRecord span;
+        span.name = std::string(payload.string());
+        span.in_progress = (payload.byte() & kSpanInProgress) != 0;
+        span.start_us = base_us + static_cast<int64_t>(payload.varint());
+        span.end_us = span.start_us + static_cast<int64_t>(payload.varint());
+        if (!read_metrics(payload, span.metrics)) {
+            return false;
+        }
+        record.spans.push_back(std::move(span));
+    }
+    return payload.ok();
+}
+
+// 跨服务传递的 span 列表：下游把自己请求的 span 编码后随响应返回，上游用 ThreadData::merge_remote 合并
+//
+//   spans := magic(2B "TS") version(1B) svarint(clock_us) svarint(base_us) varint(n_spans) span*
+//   span  := string(name) varint(start_us - base_us) varint(end_us - start_us)
+//
+// clock_us 是编码时发送方的时钟，接收方用它和 base_us 估算两边的时钟偏差；只带起止时间，不带探针指标
+constexpr char kSpansMagic[2] = {'T', 'S'};
+constexpr uint8_t kSpansVersion = 1;
+
+struct SpansHeader {
+    int64_t clock_us = 0;
+    int64_t base_us = 0;   // 所有 span 的最小开始时间
+    uint64_t count = 0;
+};
+
+// 编码 span 列表，追加到 out
+inline void append_spans(std::string& out, const std::vector<SpanRecord>& spans, int64_t clock_us) {
+    int64_t base_us = spans.empty() ? clock_us : spans[0].start_us;
+    for (auto& span : spans) {
+        base_us = std::min(base_us, span.start_us);
+    }
+    out.append(kSpansMagic, 2);
+    out += static_cast<char>(kSpansVersion);
+    put_svarint(out, clock_us);
+    put_svarint(out, base_us);
+    put_varint(out, spans.size());
+    for (auto& span : spans) {
+        put_string(out, span.name);
+        put_varint(out, static_cast<uint64_t>(span.start_us - base_us));
+        put_varint(out, static_cast<uint64_t>(std::max<int64_t>(span.end_us - span.start_us, 0)));
+    }
+}
+
+inline bool read_spans_header(Reader& reader, SpansHeader& header) {
+    std::string_view magic = reader.bytes(2);
+    if (!reader.ok() || magic[0] != kSpansMagic[0] || magic[1] != kSpansMagic[1]) {
+        return false;
+    }
+    if (reader.byte() != kSpansVersion) {
+        return false;
+    }
+    header.clock_us = reader.svarint();
+    header.base_us = reader.svarint();
+    header.count = reader.varint();
+    return reader.ok();
+}
+
+// 读一个 span，name 直接指向输入，不拷贝
+inline bool read_span(Reader& reader, const SpansHeader& header,
+        std::string_view& name, int64_t& start_us, int64_t& end_us) {
+    name = reader.string();
+    start_us = header.base_us + static_cast<int64_t>(reader.varint());
+    end_us = start_us + static_cast<int64_t>(reader.varint());
+    return reader.ok();
+}
+
+}  // namespace binary
+
+// 作为 AsyncEmitter 的 formatter，在后台线程编码
+class BinaryFormatter : public RecordFormatter {
+public:
+    void append(std::string& out, const RequestRecord& record) override {
+        binary::append_record(out, record);
+    }
+};
+
+// 二进制导出器，在调用线程编码后写到 Sink
+class BinaryExporter {
+public:
+    explicit BinaryExporter(std::shared_ptr<Sink> sink) : _sink(std::move(sink)) {}
+
+    void write(const RequestRecord& record) {
+        std::lock_guard lock(_mtx);
+        _buffer.clear();
+        binary::append_record(_buffer, record);
+        _sink->write(_buffer);
+    }
+
+    void flush() {
+        _sink->flush();
+    }
+
+private:
+    std::shared_ptr<Sink> _sink;
+    std::mutex _mtx;
+    std::string _buffer;
+};
+
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+// C++20 协程支持，低于 C++20 或没有 <coroutine> 时整个头文件为空
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include <chrono>
+#include <coroutine>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "timekeeper/timekeeper.hpp"
+
+namespace timekeeper {
+
+// 协程每次 co_await 都可能换线程恢复，线程局部的上下文（ThreadDataManager 的 Init / ContextScope）跟不过去
+// CoroutineContext 是 promise_type 的 mixin：
+//   - 创建协程时捕获当前上下文（也可以 set_context 指定）
+//   - 协程运行时挂到所在线程上，每次挂起前摘下、恢复后重新挂上，协程里 GetCurrentThreadData() 始终是这个请求
+//   - 管理协程里的 CoroutineSpan，挂起期间暂停计时
+//
+// 用法：
+//   struct promise_type : timekeeper::CoroutineContext { ... };
+// CoroutineContext 用 ThreadDataManager（ThreadLocalStorage）；别的 StoragePolicy 用 BasicCoroutineContext<StoragePolicy>，
+// 和对应的 BasicThreadDataManager<StoragePolicy> 配套
+// mixin 提供了 await_transform、initial_suspend（不挂起）和 final_suspend（挂起）；
+// promise 自己定义 initial_suspend 时用 wrap() 包一下返回的 awaiter，自己定义 final_suspend 时先调用 detach()
+// co_await timekeeper::this_coroutine 得到当前协程的 CoroutineContext&，不挂起
+struct ThisCoroutine {};
+inline constexpr ThisCoroutine this_coroutine{};
+
+class CoroutineSpan;
+
+namespace coro {
+
+inline int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 取 co_await 表达式实际使用的 awaiter：成员 operator co_await、非成员 operator co_await 或它本身
+template <typename T>
+decltype(auto) get_awaiter(T&& value) {
+    if constexpr (requires { std::forward<T>(value).operator co_await(); }) {
+        return std::forward<T>(value).operator co_await();
+    } else if constexpr (requires { operator co_await(std::forward<T>(value)); }) {
+        return operator co_await(std::forward<T>(value));
+    } else {
+        return std::forward<T>(value);
+    }
+}
+
+}  // namespace coro
+
+// 和 StoragePolicy 无关的部分：上下文和活跃 span 的链表，CoroutineSpan 只依赖这一层
+class CoroutineContextBase {
+public:
+    CoroutineContextBase(Context context) : _context(std::move(context)) {}
+
+    // disable copy, assignment, move
+    CoroutineContextBase(const CoroutineContextBase &) = delete;
+    CoroutineContextBase& operator=(const CoroutineContextBase &) = delete;
+
+    // 在协程开始运行前调用
+    void set_context(Context context) {
+        _context = std::move(context);
+    }
+
+    const Context& context() const {
+        return _context;
+    }
+
+protected:
+    // 恢复/暂停所有活跃的 span
+    inline void resume_spans();
+    inline void pause_spans();
+
+    Context _context;
+
+private:
+    friend class CoroutineSpan;
+
+    CoroutineSpan* _spans = nullptr;   // 活跃 span 的侵入式链表，协程同一时刻只在一个线程上运行，不需要加锁
+};
+
+template <typename StoragePolicy>
+class BasicCoroutineContext : public CoroutineContextBase {
+public:
+    using Manager = BasicThreadDataManager<StoragePolicy>;
+
+    // 包装 awaiter：挂起前摘下上下文，恢复后重新挂上
+    template <typename Awaitable>
+    class Awaiter {
+    public:
+        // 引用 co_await 的左值；右值（包括临时对象）移动进来保存，避免悬空
+        using Result = decltype(coro::get_awaiter(std::declval<Awaitable>()));
+        using AwaiterType = std::conditional_t<std::is_lvalue_reference_v<Result>, Result, std::remove_cvref_t<Result>>;
+
+        Awaiter(Awaitable&& awaitable, BasicCoroutineContext& owner)
+            : _awaiter(coro::get_awaiter(std::forward<Awaitable>(awaitable))), _owner(owner) {}
+
+        bool await_ready() {
+            return _awaiter.await_ready();
+        }
+
+        // 摘下必须在转交给内层之前：内层 await_suspend 返回前协程可能已经在别的线程上恢复
+        template <typename Promise>
+        decltype(auto) await_suspend(std::coroutine_handle<Promise> handle) {
+            _owner.detach();
+            return _awaiter.await_suspend(handle);
+        }
+
+        decltype(auto) await_resume() {
+            _owner.attach();
+            return _awaiter.await_resume();
+        }
+
+    private:
+        AwaiterType _awaiter;
+        BasicCoroutineContext& _owner;
+    };
+
+    struct SelfAwaiter {
+        BasicCoroutineContext& owner;
+
+        bool await_ready() noexcept { return true; }
+        void await_suspend(std::coroutine_handle<>) noexcept {}
+        BasicCoroutineContext& await_resume() noexcept { return owner; }
+    };
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<>) noexcept {}
+        void await_resume() noexcept {}
+    };
+
+    BasicCoroutineContext() : CoroutineContextBase(Manager::Instance().Capture()) {}
+
+    template <typename Awaitable>
+    Awaiter<Awaitable> wrap(Awaitable&& awaitable) {
+        return Awaiter<Awaitable>(std::forward<Awaitable>(awaitable), *this);
+    }
+
+    template <typename Awaitable>
+        requires (!std::is_same_v<std::remove_cvref_t<Awaitable>, ThisCoroutine>)
+    Awaiter<Awaitable> await_transform(Awaitable&& awaitable) {
+        return wrap(std::forward<Awaitable>(awaitable));
+    }
+
+    SelfAwaiter await_transform(ThisCoroutine) {
+        return SelfAwaiter{*this};
+    }
+
+    auto initial_suspend() {
+        return wrap(std::suspend_never{});
+    }
+
+    FinalAwaiter final_suspend() noexcept {
+        detach();
+        return {};
+    }
+
+    // 把上下文挂到当前线程，恢复暂停的 span；重复调用无效果
+    void attach() {
+        if (_attached) {
+            return;
+        }
+        _attached = true;
+        if (_context) {
+            _previous = Manager::ExchangeAttached(&_context.data());
+        }
+        resume_spans();
+    }
+
+    // 恢复线程原来的上下文，暂停运行中的 span；重复调用无效果
+    void detach() {
+        if (!_attached) {
+            return;
+        }
+        _attached = false;
+        if (_context) {
+            Manager::ExchangeAttached(_previous);
+            _previous = nullptr;
+        }
+        pause_spans();
+    }
+
+private:
+    bool _attached = false;
+    const std::shared_ptr<ThreadData>* _previous = nullptr;
+};
+
+using CoroutineContext = BasicCoroutineContext<ThreadLocalStorage>;
+
+// 协程里的 span，排除挂起的时间：记录为普通 span（墙上时间），active 指标是实际运行的时间
+//   timekeeper::CoroutineSpan span(co_await timekeeper::this_coroutine, "fetch");
+// 只统计本协程自己运行的时间，co_await 子协程期间算作挂起
+// 析构或 end() 时提交到协程上下文对应的 ThreadData；没有上下文时不记录
+class CoroutineSpan {
+public:
+    CoroutineSpan(CoroutineContextBase& owner, std::string name)
+        : _owner(owner), _name(std::move(name)) {
+        _start_us = coro::now_us();
+        _resumed_at = _start_us;
+        _next = _owner._spans;
+        if (_next) {
+            _next->_prev = this;
+        }
+        _owner._spans = this;
+    }
+
+    ~CoroutineSpan() {
+        end();
+    }
+
+    // disable copy, assignment, move
+    CoroutineSpan(const CoroutineSpan &) = delete;
+    CoroutineSpan& operator=(const CoroutineSpan &) = delete;
+    CoroutineSpan(CoroutineSpan &&) = delete;
+
+    void end() {
+        if (_ended) {
+            return;
+        }
+        _ended = true;
+        int64_t now = coro::now_us();
+        if (_running) {
+            _active_us += now - _resumed_at;
+        }
+        unlink();
+
+        auto& data = _owner._context.data();
+        if (!data) {
+            return;
+        }
+        TimeRecorder::Sample sample;
+        sample.start_us = _start_us;
+        sample.end_us = now;
+        sample.metrics.active_us = _active_us;
+        sample.metrics.active_wall_us = now - _start_us;
+        data->add_sample(_name, sample);
+    }
+
+private:
+    friend class CoroutineContextBase;
+
+    void pause(int64_t now) {
+        if (_running) {
+            _active_us += now - _resumed_at;
+            _running = false;
+        }
+    }
+
+    void resume(int64_t now) {
+        if (!_running) {
+            _resumed_at = now;
+            _running = true;
+        }
+    }
+
+    void unlink() {
+        if (_prev) {
+            _prev->_next = _next;
+        } else {
+            _owner._spans = _next;
+        }
+        if (_next) {
+            _next->_prev = _prev;
+        }
+        _prev = _next = nullptr;
+    }
+
+    CoroutineContextBase& _owner;
+    std::string _name;
+    int64_t _start_us;
+    int64_t _resumed_at;
+    int64_t _active_us = 0;
+    bool _running = true;
+    bool _ended = false;
+    CoroutineSpan* _prev = nullptr;
+    CoroutineSpan* _next = nullptr;
+};
+
+inline void CoroutineContextBase::resume_spans() {
+    if (_spans) {
+        int64_t now = coro::now_us();
+        for (auto span = _spans; span; span = span->_next) {
+            span->resume(now);
+        }
+    }
+}
+
+inline void CoroutineContextBase::pause_spans() {
+    if (_spans) {
+        int64_t now = coro::now_us();
+        for (auto span = _spans; span; span = span->_next) {
+            span->pause(now);
+        }
+    }
+}
+
+}
+
+#endif
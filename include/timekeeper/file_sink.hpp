@@ -0,0 +1,239 @@
+#pragma once
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "timekeeper/sink.hpp"
+
+namespace timekeeper {
+
+// 带缓冲的文件输出
+// 记录先追加到大块内存里，攒够 flush_bytes 或者超过 flush_interval 才用一次 writev 落盘，
+// 文件以 O_APPEND 打开；按大小或时间切分文件，旧文件依次改名为 path.1 path.2 ...
+class FileSink : public Sink {
+public:
+    struct Options {
+        std::string path;
+        size_t buffer_size = 1 << 20;                   // 单块缓冲区大小
+        size_t flush_bytes = 4 << 20;                   // 累计多少字节触发一次刷盘
+        std::chrono::milliseconds flush_interval{1000}; // 距上次刷盘超过该时间也会刷盘
+        // 单个文件达到 rotate_bytes 后，在下一次刷盘前切分，0 表示不切分
+        // 一次刷盘的数据整批写进同一个文件，不拆开记录，所以文件最大约为 rotate_bytes + flush_bytes（再加一条记录）
+        size_t rotate_bytes = 0;
+        std::chrono::seconds rotate_interval{0};        // 单个文件超过该时长时切分，0 表示不切分
+        int max_files = 5;                              // 最多保留多少个切分出来的旧文件
+    };
+
+    // 统计信息，可以在任意线程读取
+    struct Stats {
+        std::atomic<uint64_t> bytes_written{0};
+        std::atomic<uint64_t> writes{0};           // write() 调用次数
+        std::atomic<uint64_t> flushes{0};          // 落盘次数
+        std::atomic<uint64_t> syscalls{0};         // writev 调用次数
+        std::atomic<uint64_t> rotations{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> flush_us_total{0};   // 落盘累计耗时
+        std::atomic<uint64_t> flush_us_max{0};     // 单次落盘最大耗时
+    };
+
+    // disable copy, assignment, move
+    FileSink(const FileSink &) = delete;
+    FileSink& operator=(const FileSink &) = delete;
+    FileSink(FileSink &&) = delete;
+
+    explicit FileSink(const std::string& path) : FileSink(make_options(path)) {}
+
+    explicit FileSink(Options options) : _options(std::move(options)) {
+        _options.buffer_size = std::max<size_t>(_options.buffer_size, 4096);
+        _last_flush = steady_clock::now();
+        std::lock_guard lock(_mtx);
+        open_file();
+    }
+
+    ~FileSink() override {
+        std::lock_guard lock(_mtx);
+        flush_locked();
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+    }
+
+    void write(std::string_view data) override {
+        std::lock_guard lock(_mtx);
+        _stats.writes.fetch_add(1, std::memory_order_relaxed);
+        while (!data.empty()) {
+            if (_chunks.empty() || _chunks.back().size() == _options.buffer_size) {
+                _chunks.emplace_back();
+                _chunks.back().reserve(_options.buffer_size);
+            }
+            std::string& chunk = _chunks.back();
+            size_t n = std::min(data.size(), _options.buffer_size - chunk.size());
+            chunk.append(data.data(), n);
+            data.remove_prefix(n);
+            _pending += n;
+        }
+        if (_pending >= _options.flush_bytes || flush_due()) {
+            flush_locked();
+        }
+    }
+
+    void flush() override {
+        std::lock_guard lock(_mtx);
+        flush_locked();
+    }
+
+    void poll() override {
+        std::lock_guard lock(_mtx);
+        if (flush_due()) {
+            flush_locked();
+        } else if (rotate_due()) {
+            rotate();
+        }
+    }
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    using steady_clock = std::chrono::steady_clock;
+
+    static Options make_options(const std::string& path) {
+        Options options;
+        options.path = path;
+        return options;
+    }
+
+    bool flush_due() const {
+        return _pending > 0 && steady_clock::now() - _last_flush >= _options.flush_interval;
+    }
+
+    bool rotate_due() const {
+        if (_options.rotate_bytes > 0 && _file_bytes >= _options.rotate_bytes) {
+            return true;
+        }
+        return _options.rotate_interval.count() > 0
+            && steady_clock::now() - _opened_at >= _options.rotate_interval;
+    }
+
+    void open_file() {
+        _fd = ::open(_options.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (_fd < 0) {
+            _stats.errors.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "open log file failed, path: " << _options.path
+                << ", error: " << strerror(errno) << std::endl;
+            return;
+        }
+        struct stat st;
+        _file_bytes = ::fstat(_fd, &st) == 0 ? st.st_size : 0;
+        _opened_at = steady_clock::now();
+    }
+
+    // path.(n-1) -> path.n ... path -> path.1，超出 max_files 的最旧文件被覆盖
+    void rotate() {
+        if (_fd >= 0) {
+            ::close(_fd);
+            _fd = -1;
+        }
+        for (int i = _options.max_files - 1; i >= 1; --i) {
+            std::string from = _options.path + "." + std::to_string(i);
+            std::string to = _options.path + "." + std::to_string(i + 1);
+            ::rename(from.c_str(), to.c_str());
+        }
+        if (_options.max_files > 0) {
+            ::rename(_options.path.c_str(), (_options.path + ".1").c_str());
+        } else {
+            ::unlink(_options.path.c_str());
+        }
+        _stats.rotations.fetch_add(1, std::memory_order_relaxed);
+        open_file();
+    }
+
+    void flush_locked() {
+        _last_flush = steady_clock::now();
+        if (_pending == 0) {
+            return;
+        }
+        if (rotate_due()) {
+            rotate();
+        }
+
+        auto begin = steady_clock::now();
+        std::vector<struct iovec>& iov = _iov;
+        iov.clear();
+        for (auto& chunk : _chunks) {
+            if (!chunk.empty()) {
+                iov.push_back({chunk.data(), chunk.size()});
+            }
+        }
+
+        size_t idx = 0;
+        while (idx < iov.size() && _fd >= 0) {
+            int cnt = static_cast<int>(std::min<size_t>(iov.size() - idx, IOV_MAX));
+            ssize_t n = ::writev(_fd, iov.data() + idx, cnt);
+            _stats.syscalls.fetch_add(1, std::memory_order_relaxed);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                _stats.errors.fetch_add(1, std::memory_order_relaxed);
+                std::cerr << "write log file failed, path: " << _options.path
+                    << ", error: " << strerror(errno) << std::endl;
+                break;
+            }
+            _file_bytes += n;
+            _stats.bytes_written.fetch_add(n, std::memory_order_relaxed);
+            // 处理部分写入
+            while (n > 0 && idx < iov.size()) {
+                if (static_cast<size_t>(n) >= iov[idx].iov_len) {
+                    n -= iov[idx].iov_len;
+                    ++idx;
+                } else {
+                    iov[idx].iov_base = static_cast<char*>(iov[idx].iov_base) + n;
+                    iov[idx].iov_len -= n;
+                    n = 0;
+                }
+            }
+        }
+
+        // 保留第一块缓冲区复用，避免每次刷盘后重新分配
+        _chunks.resize(1);
+        _chunks[0].clear();
+        _pending = 0;
+
+        auto cost = std::chrono::duration_cast<std::chrono::microseconds>(steady_clock::now() - begin).count();
+        _stats.flushes.fetch_add(1, std::memory_order_relaxed);
+        _stats.flush_us_total.fetch_add(cost, std::memory_order_relaxed);
+        if (static_cast<uint64_t>(cost) > _stats.flush_us_max.load(std::memory_order_relaxed)) {
+            _stats.flush_us_max.store(cost, std::memory_order_relaxed);
+        }
+    }
+
+    Options _options;
+    Stats _stats;
+
+    std::mutex _mtx;
+    int _fd = -1;
+    size_t _file_bytes = 0;
+    steady_clock::time_point _opened_at;
+    steady_clock::time_point _last_flush;
+
+    std::vector<std::string> _chunks;
+    std::vector<struct iovec> _iov;
+    size_t _pending = 0;
+};
+
+}
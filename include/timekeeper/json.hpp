@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "timekeeper/log_fields.hpp"
+#include "timekeeper/record.hpp"
+
+namespace timekeeper {
+
+// 追加带引号的 JSON 字符串，按 RFC 8259 转义
+inline void append_json_string(std::string& out, std::string_view s) {
+    out += '"';
+    for (char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    out += buffer;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+// JSON 没有 inf/nan，非有限值按 proto3 JSON 的约定输出为字符串 "NaN"、"Infinity"、"-Infinity"
+inline void append_json_double(std::string& out, double v) {
+    if (std::isnan(v)) {
+        out += "\"NaN\"";
+    } else if (std::isinf(v)) {
+        out += v > 0 ? "\"Infinity\"" : "\"-Infinity\"";
+    } else {
+        LogValue(v).append_to(out);
+    }
+}
+
+// 字段值按类型输出为 JSON 的 number/bool/string
+inline void append_json_value(std::string& out, const LogValue& value) {
+    if (value.type() == LogValue::Type::kString) {
+        append_json_string(out, value.as_string());
+    } else if (value.type() == LogValue::Type::kDouble) {
+        append_json_double(out, value.as_double());
+    } else {
+        value.append_to(out);
+    }
+}
+
+// span 的附加指标和进行中标记，逐个追加为 ,"key":value，和 SpanMetrics::for_each 的名字一致
+// 没有采集的指标不输出，in_progress 只在为 true 时输出
+inline void append_json_span_extras(std::string& out, const SpanRecord& span) {
+    span.metrics.for_each([&out](std::string_view key, int64_t value) {
+        out += ',';
+        append_json_string(out, key);
+        out += ':';
+        out += std::to_string(value);
+    });
+    if (span.in_progress) {
+        out += ",\"in_progress\":true";
+    }
+}
+
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace timekeeper {
+
+// 带内联容量的 vector，元素个数不超过 N 时不做堆分配
+// 只实现 LogFields 需要的接口，不支持拷贝和移动
+template <typename T, size_t N>
+class SmallVector {
+public:
+    SmallVector(const SmallVector &) = delete;
+    SmallVector& operator=(const SmallVector &) = delete;
+
+    SmallVector() : _data(inline_data()), _size(0), _capacity(N) {}
+
+    ~SmallVector() {
+        clear();
+        if (!is_inline()) {
+            ::operator delete(_data);
+        }
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (_size == _capacity) {
+            grow(_capacity * 2);
+        }
+        T* p = new (_data + _size) T(std::forward<Args>(args)...);
+        ++_size;
+        return *p;
+    }
+
+    void reserve(size_t n) {
+        if (n > _capacity) {
+            grow(n);
+        }
+    }
+
+    void clear() {
+        for (size_t i = 0; i < _size; ++i) {
+            _data[i].~T();
+        }
+        _size = 0;
+    }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    T& operator[](size_t i) { return _data[i]; }
+    const T& operator[](size_t i) const { return _data[i]; }
+
+    T* begin() { return _data; }
+    T* end() { return _data + _size; }
+    const T* begin() const { return _data; }
+    const T* end() const { return _data + _size; }
+
+private:
+    T* inline_data() { return reinterpret_cast<T*>(_inline); }
+    bool is_inline() const { return _data == reinterpret_cast<const T*>(_inline); }
+
+    void grow(size_t new_capacity) {
+        T* new_data = static_cast<T*>(::operator new(new_capacity * sizeof(T)));
+        for (size_t i = 0; i < _size; ++i) {
+            new (new_data + i) T(std::move(_data[i]));
+            _data[i].~T();
+        }
+        if (!is_inline()) {
+            ::operator delete(_data);
+        }
+        _data = new_data;
+        _capacity = new_capacity;
+    }
+
+    alignas(T) unsigned char _inline[N * sizeof(T)];
+    T* _data;
+    size_t _size;
+    size_t _capacity;
+};
+
+// 日志字段的值，带类型标记
+// 数字和布尔值直接存储，格式化推迟到 report/导出时，请求路径上不做 to_string
+class LogValue {
+public:
+    // 有符号整数存为 kInt，无符号整数存为 kUint
+    enum class Type : uint8_t { kString, kInt, kDouble, kBool, kUint };
+
+    LogValue() : _type(Type::kString), _i(0) {}
+    LogValue(std::string_view v) : _type(Type::kString), _i(0), _s(v) {}
+    LogValue(const std::string& v) : _type(Type::kString), _i(0), _s(v) {}
+    // 没有这个重载的话，字符串字面量会优先匹配到 bool
+    LogValue(const char* v) : _type(Type::kString), _i(0), _s(v) {}
+    LogValue(double v) : _type(Type::kDouble), _d(v) {}
+    LogValue(bool v) : _type(Type::kBool), _b(v) {}
+
+    // 所有整数类型都走这里，避免 int、unsigned 等在 int64_t/uint64_t/double/bool 之间二义
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+    LogValue(T v) : _type(std::is_signed_v<T> ? Type::kInt : Type::kUint), _i(0) {
+        if constexpr (std::is_signed_v<T>) {
+            _i = static_cast<int64_t>(v);
+        } else {
+            _u = static_cast<uint64_t>(v);
+        }
+    }
+
+    Type type() const { return _type; }
+    int64_t as_int() const { return _i; }
+    uint64_t as_uint() const { return _u; }
+    double as_double() const { return _d; }
+    bool as_bool() const { return _b; }
+    const std::string& as_string() const { return _s; }
+
+    // 追加格式化后的文本
+    void append_to(std::string& out) const {
+        char buffer[32];
+        int n = 0;
+        switch (_type) {
+            case Type::kString:
+                out += _s;
+                return;
+            case Type::kInt:
+                n = snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(_i));
+                break;
+            case Type::kUint:
+                n = snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(_u));
+                break;
+            case Type::kDouble:
+                n = format_double(buffer, sizeof(buffer), _d);
+                break;
+            case Type::kBool:
+                out += _b ? "true" : "false";
+                return;
+        }
+        out.append(buffer, n);
+    }
+
+    std::string to_string() const {
+        std::string out;
+        append_to(out);
+        return out;
+    }
+
+    // 能精确还原的最短格式：先试 15 位有效数字，读回来不相等再用 17 位
+    static int format_double(char* buffer, size_t size, double v) {
+        int n = snprintf(buffer, size, "%.15g", v);
+        if (std::strtod(buffer, nullptr) != v) {
+            n = snprintf(buffer, size, "%.17g", v);
+        }
+        return n;
+    }
+
+private:
+    Type _type;
+    union {
+        int64_t _i;
+        uint64_t _u;
+        double _d;
+        bool _b;
+    };
+    std::string _s;
+};
+
+// 日志字段的扁平存储，替代 std::map<std::string, std::string>
+// 典型请求字段数 < 16，全部落在内联数组里，查找是线性扫描（先比长度再 memcmp）
+// 写入时不维护顺序，report 时才按 key 排序，输出顺序与原先 std::map 一致
+class LogFields {
+public:
+    struct Field {
+        std::string key;
+        LogValue value;
+    };
+
+    static constexpr size_t kInlineCapacity = 16;
+
+    // 首次写入生效，need_overwrite 为 true 时覆盖已有的值
+    // 返回是否写入
+    bool set(std::string_view key, LogValue value, bool need_overwrite = false) {
+        if (Field* field = find_field(key)) {
+            if (!need_overwrite) {
+                return false;
+            }
+            field->value = std::move(value);
+            return true;
+        }
+        _fields.emplace_back(Field{std::string(key), std::move(value)});
+        _sorted = false;
+        return true;
+    }
+
+    const LogValue* find(std::string_view key) const {
+        const Field* field = const_cast<LogFields*>(this)->find_field(key);
+        return field ? &field->value : nullptr;
+    }
+
+    size_t size() const { return _fields.size(); }
+    bool empty() const { return _fields.empty(); }
+
+    void reserve(size_t n) { _fields.reserve(n); }
+
+    // 按 key 升序遍历
+    template <typename F>
+    void for_each_sorted(F&& f) {
+        sort();
+        for (const auto& field : _fields) {
+            f(field.key, field.value);
+        }
+    }
+
+private:
+    Field* find_field(std::string_view key) {
+        for (auto& field : _fields) {
+            if (field.key.size() == key.size()
+                && std::memcmp(field.key.data(), key.data(), key.size()) == 0) {
+                return &field;
+            }
+        }
+        return nullptr;
+    }
+
+    void sort() {
+        if (_sorted) {
+            return;
+        }
+        std::sort(_fields.begin(), _fields.end(), [](const Field& a, const Field& b) {
+            return a.key < b.key;
+        });
+        _sorted = true;
+    }
+
+    SmallVector<Field, kInlineCapacity> _fields;
+    bool _sorted = true;
+};
+
+}
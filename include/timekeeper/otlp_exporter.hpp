@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "timekeeper/async_emitter.hpp"
+#include "timekeeper/json.hpp"
+#include "timekeeper/record.hpp"
+
+namespace timekeeper {
+
+// OTLP/JSON 格式（ExportTraceServiceRequest），每批记录输出一行，
+// 可以直接交给 OpenTelemetry Collector 的 file receiver（otlpjsonfile）
+//
+// 映射关系：
+//   - logid 作为 trace id：本身是 32 位十六进制时直接使用，否则取哈希
+//   - 每个请求生成一个名为 "request" 的根 span，覆盖所有 span，log fields 和 logid 作为它的 attributes
+//   - span 之间没有显式的父子关系，按时间区间包含关系推断：包含它的最内层 span 是父 span
+//   - 探针采集的指标（SpanMetrics）作为 span 的 attributes
+//
+// 格式化在后台线程进行，所有中间缓冲区在批次之间复用
+class OtlpJsonFormatter : public RecordFormatter {
+public:
+    explicit OtlpJsonFormatter(std::string service_name = "timekeeper") {
+        _batch_prefix = "{\"resourceSpans\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\",\"value\":{\"stringValue\":";
+        append_json_string(_batch_prefix, service_name);
+        _batch_prefix += "}}]},\"scopeSpans\":[{\"scope\":{\"name\":\"timekeeper\"},\"spans\":[";
+    }
+
+    void begin_batch(std::string& out) override {
+        out += _batch_prefix;
+        _first = true;
+    }
+
+    void append(std::string& out, const RequestRecord& record) override {
+        char trace_id[32];
+        make_trace_id(record.logid, trace_id);
+        // 同一个 logid 可能出现多次（重试），span id 的种子里加上序号避免冲突
+        uint64_t seed = fnv1a(record.logid, 0xcbf29ce484222325ULL) ^ mix(_sequence++);
+
+        int64_t begin_us = 0;
+        int64_t end_us = 0;
+        if (!record.spans.empty()) {
+            begin_us = record.spans[0].start_us;
+            end_us = record.spans[0].end_us;
+            for (auto& span : record.spans) {
+                begin_us = std::min(begin_us, span.start_us);
+                end_us = std::max(end_us, span.end_us);
+            }
+        }
+
+        // 根 span
+        uint64_t root_id = span_id(seed, 0);
+        begin_span(out, trace_id, root_id, 0, "request", begin_us, end_us);
+        out += ",\"attributes\":[";
+        append_attribute(out, "logid", LogValue(std::string_view(record.logid)));
+        for (auto& field : record.fields) {
+            out += ',';
+            append_attribute(out, field.first, field.second);
+        }
+        out += "]}";
+
+        // 按 (start 升序, end 降序) 排序后用栈推断父 span
+        _order.resize(record.spans.size());
+        for (size_t i = 0; i < _order.size(); ++i) {
+            _order[i] = static_cast<uint32_t>(i);
+        }
+        std::sort(_order.begin(), _order.end(), [&record](uint32_t a, uint32_t b) {
+            const SpanRecord& x = record.spans[a];
+            const SpanRecord& y = record.spans[b];
+            if (x.start_us != y.start_us) {
+                return x.start_us < y.start_us;
+            }
+            return x.end_us > y.end_us;
+        });
+
+        _stack.clear();
+        for (uint32_t idx : _order) {
+            const SpanRecord& span = record.spans[idx];
+            while (!_stack.empty() && record.spans[_stack.back()].end_us < span.end_us) {
+                _stack.pop_back();
+            }
+            uint64_t parent = _stack.empty() ? root_id : span_id(seed, _stack.back() + 1);
+            begin_span(out, trace_id, span_id(seed, idx + 1), parent, span.name, span.start_us, span.end_us);
+            if (!span.metrics.empty()) {
+                out += ",\"attributes\":[";
+                bool first = true;
+                span.metrics.for_each([&](std::string_view key, int64_t value) {
+                    if (!first) {
+                        out += ',';
+                    }
+                    first = false;
+                    append_attribute(out, key, LogValue(value));
+                });
+                out += ']';
+            }
+            out += '}';
+            _stack.push_back(idx);
+        }
+    }
+
+    void end_batch(std::string& out) override {
+        out += "]}]}]}\n";
+    }
+
+private:
+    static uint64_t fnv1a(std::string_view s, uint64_t basis) {
+        uint64_t h = basis;
+        for (char c : s) {
+            h ^= static_cast<uint8_t>(c);
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    static uint64_t mix(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // span id 不能全为 0
+    static uint64_t span_id(uint64_t seed, uint64_t index) {
+        uint64_t id = mix(seed ^ (index * 0x9e3779b97f4a7c15ULL));
+        return id ? id : 1;
+    }
+
+    static void to_hex(uint64_t v, char* out) {
+        static const char kDigits[] = "0123456789abcdef";
+        for (int i = 15; i >= 0; --i) {
+            out[i] = kDigits[v & 0xf];
+            v >>= 4;
+        }
+    }
+
+    static void make_trace_id(const std::string& logid, char* out) {
+        bool is_hex = logid.size() == 32 && std::all_of(logid.begin(), logid.end(), [](char c) {
+            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+        });
+        if (is_hex) {
+            for (size_t i = 0; i < 32; ++i) {
+                out[i] = static_cast<char>(logid[i] >= 'A' && logid[i] <= 'F' ? logid[i] - 'A' + 'a' : logid[i]);
+            }
+            return;
+        }
+        to_hex(mix(fnv1a(logid, 0xcbf29ce484222325ULL)), out);
+        to_hex(mix(fnv1a(logid, 0x84222325cbf29ce4ULL)), out + 16);
+    }
+
+    static void append_int(std::string& out, int64_t v) {
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), v);
+        out.append(buffer, result.ptr - buffer);
+    }
+
+    // 输出 span 的公共部分，不含结尾的 '}'
+    void begin_span(std::string& out, const char* trace_id, uint64_t id, uint64_t parent,
+            std::string_view name, int64_t start_us, int64_t end_us) {
+        char hex[16];
+        out += _first ? "{\"traceId\":\"" : ",{\"traceId\":\"";
+        _first = false;
+        out.append(trace_id, 32);
+        out += "\",\"spanId\":\"";
+        to_hex(id, hex);
+        out.append(hex, 16);
+        if (parent) {
+            out += "\",\"parentSpanId\":\"";
+            to_hex(parent, hex);
+            out.append(hex, 16);
+        }
+        out += "\",\"name\":";
+        append_json_string(out, name);
+        // SPAN_KIND_INTERNAL；64 位整数在 OTLP/JSON 里编码为字符串
+        out += ",\"kind\":1,\"startTimeUnixNano\":\"";
+        append_int(out, start_us * 1000);
+        out += "\",\"endTimeUnixNano\":\"";
+        append_int(out, end_us * 1000);
+        out += '"';
+    }
+
+    static void append_attribute(std::string& out, std::string_view key, const LogValue& value) {
+        out += "{\"key\":";
+        append_json_string(out, key);
+        out += ",\"value\":{";
+        switch (value.type()) {
+            case LogValue::Type::kString:
+                out += "\"stringValue\":";
+                append_json_string(out, value.as_string());
+                break;
+            case LogValue::Type::kInt:
+                out += "\"intValue\":\"";
+                append_int(out, value.as_int());
+                out += '"';
+                break;
+            case LogValue::Type::kUint:
+                // intValue 是 int64，放不下的无符号数按字符串输出
+                if (value.as_uint() <= static_cast<uint64_t>(INT64_MAX)) {
+                    out += "\"intValue\":\"";
+                    append_int(out, static_cast<int64_t>(value.as_uint()));
+                } else {
+                    out += "\"stringValue\":\"";
+                    value.append_to(out);
+                }
+                out += '"';
+                break;
+            case LogValue::Type::kDouble:
+                out += "\"doubleValue\":";
+                append_json_double(out, value.as_double());
+                break;
+            case LogValue::Type::kBool:
+                out += "\"boolValue\":";
+                value.append_to(out);
+                break;
+        }
+        out += "}}";
+    }
+
+    std::string _batch_prefix;
+    bool _first = true;
+    uint64_t _sequence = 0;
+    std::vector<uint32_t> _order;
+    std::vector<uint32_t> _stack;
+};
+
+// OTLP/JSON 文件导出：AsyncEmitter + OtlpJsonFormatter，每 batch_requests 个请求一行
+// 用法与 AsyncEmitter 相同，例如 data.emit_async(exporter)
+class OtlpJsonExporter : public AsyncEmitter {
+public:
+    struct Options {
+        std::string service_name = "timekeeper";
+        size_t batch_requests = 64;                     // 每行最多包含多少个请求
+        size_t capacity = 8192;                         // 队列长度
+        OverflowPolicy policy = OverflowPolicy::kDrop;
+        std::chrono::milliseconds flush_interval{100};
+    };
+
+    explicit OtlpJsonExporter(std::shared_ptr<Sink> sink) : OtlpJsonExporter(std::move(sink), Options()) {}
+
+    OtlpJsonExporter(std::shared_ptr<Sink> sink, const Options& options)
+        : AsyncEmitter(std::move(sink), make_emitter_options(options)) {}
+
+private:
+    static AsyncEmitter::Options make_emitter_options(const Options& options) {
+        AsyncEmitter::Options result;
+        result.capacity = options.capacity;
+        result.batch_size = options.batch_requests;
+        result.policy = options.policy;
+        result.flush_interval = options.flush_interval;
+        result.formatter = std::make_shared<OtlpJsonFormatter>(options.service_name);
+        return result;
+    }
+};
+
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace timekeeper {
+
+// 计时器自身开销的统计：add_recorder、记录上传、report/make_record 里花的时间
+// 用 TSC 计数（x86 上一次 rdtsc 约 20 个周期），其他平台退化为 steady_clock 纳秒
+// 默认关闭，打开后每个请求的输出里多一个名为 "__timekeeper_overhead" 的 span，
+// 同时累加到进程级计数，用来回答“计时器占请求耗时的百分之几”
+//
+// 自适应模式：按窗口统计开销占比，超出预算时逐级降低采集的细节，回落到预算一半以下再逐级恢复
+//   kFull     正常采集
+//   kNoProbes 忽略探针（CPU 时间、perf、rusage、堆分配），只记墙上时间
+//   kMinimal  在 kNoProbes 基础上不再写进程级的 SpanStats
+namespace overhead {
+
+inline uint64_t now_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// tick 换算成纳秒：第一次使用时用 steady_clock 在 2ms 的区间上标定一次，之后不变
+// Overhead::set_enabled 会先调用一次，标定的等待不会落在请求路径上
+inline double ns_per_tick() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const double value = [] {
+        auto base_time = std::chrono::steady_clock::now();
+        uint64_t base_ticks = now_ticks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        uint64_t elapsed_ticks = now_ticks() - base_ticks;
+        auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - base_time).count();
+        return elapsed_ticks ? static_cast<double>(elapsed_ns) / elapsed_ticks : 1.0;
+    }();
+    return value;
+#else
+    return 1.0;
+#endif
+}
+
+// 当前线程上嵌套的 OverheadScope 层数，只有最外层计数，避免同一段时间重复计入
+inline thread_local int scope_depth = 0;
+
+}  // namespace overhead
+
+// 一个请求（TimeCounter）累计的开销 tick 数
+class OverheadCounter {
+public:
+    void add(uint64_t ticks) { _ticks.fetch_add(ticks, std::memory_order_relaxed); }
+    uint64_t ticks() const { return _ticks.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> _ticks{0};
+};
+
+class Overhead {
+public:
+    enum class Level : int {
+        kFull = 0,
+        kNoProbes = 1,
+        kMinimal = 2,
+    };
+
+    struct Snapshot {
+        uint64_t requests;
+        uint64_t overhead_ns;
+        uint64_t request_ns;   // 请求的墙上时间之和（所有 span 的最早开始到最晚结束）
+        double ratio;          // overhead_ns / request_ns
+        Level level;
+    };
+
+    // disable copy, assignment, move
+    Overhead(const Overhead &) = delete;
+    Overhead& operator=(const Overhead &) = delete;
+    Overhead(Overhead &&) = delete;
+
+    Overhead() {}
+
+    static Overhead& Instance() {
+        static Overhead instance;
+        return instance;
+    }
+
+    void set_enabled(bool enabled) {
+        // 提前完成 tick 标定
+        overhead::ns_per_tick();
+        _enabled.store(enabled, std::memory_order_relaxed);
+    }
+    bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    // 预算是开销占请求耗时的比例，例如 0.01 表示 1%；小于等于 0 时关闭自适应
+    // 自适应依赖开销统计，需要同时 set_enabled(true)
+    void set_budget(double ratio, uint64_t window_requests = 256) {
+        _budget.store(ratio, std::memory_order_relaxed);
+        _window_requests.store(window_requests ? window_requests : 1, std::memory_order_relaxed);
+        if (ratio <= 0) {
+            _level.store(static_cast<int>(Level::kFull), std::memory_order_relaxed);
+        }
+    }
+
+    Level level() const { return static_cast<Level>(_level.load(std::memory_order_relaxed)); }
+
+    // 当前级别下新建记录实际使用的探针
+    uint32_t effective_probes(uint32_t probes) const {
+        return level() == Level::kFull ? probes : 0;
+    }
+
+    bool stats_allowed() const { return level() != Level::kMinimal; }
+
+    // 请求已经结算（on_request）之后才发生的开销，例如 report 的格式化，只计入进程级和窗口的开销
+    void add_late(uint64_t overhead_ticks) {
+        _overhead_ticks.fetch_add(overhead_ticks, std::memory_order_relaxed);
+        if (_budget.load(std::memory_order_relaxed) > 0) {
+            _window_overhead_ticks.fetch_add(overhead_ticks, std::memory_order_relaxed);
+        }
+    }
+
+    // 一个请求结束（make_record）时调用
+    void on_request(uint64_t overhead_ticks, int64_t request_us) {
+        _requests.fetch_add(1, std::memory_order_relaxed);
+        _overhead_ticks.fetch_add(overhead_ticks, std::memory_order_relaxed);
+        if (request_us > 0) {
+            _request_ns.fetch_add(static_cast<uint64_t>(request_us) * 1000, std::memory_order_relaxed);
+        }
+        if (_budget.load(std::memory_order_relaxed) > 0) {
+            adapt(overhead_ticks, request_us);
+        }
+    }
+
+    Snapshot snapshot() const {
+        Snapshot snapshot;
+        snapshot.requests = _requests.load(std::memory_order_relaxed);
+        snapshot.overhead_ns = static_cast<uint64_t>(
+                _overhead_ticks.load(std::memory_order_relaxed) * overhead::ns_per_tick());
+        snapshot.request_ns = _request_ns.load(std::memory_order_relaxed);
+        snapshot.ratio = snapshot.request_ns ? static_cast<double>(snapshot.overhead_ns) / snapshot.request_ns : 0.0;
+        snapshot.level = level();
+        return snapshot;
+    }
+
+private:
+    // 窗口满了之后由凑满窗口的那个线程结算，其他线程只做累加
+    void adapt(uint64_t overhead_ticks, int64_t request_us) {
+        _window_overhead_ticks.fetch_add(overhead_ticks, std::memory_order_relaxed);
+        _window_request_us.fetch_add(request_us > 0 ? request_us : 0, std::memory_order_relaxed);
+        uint64_t n = _window_count.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (n < _window_requests.load(std::memory_order_relaxed)) {
+            return;
+        }
+        if (!_window_count.compare_exchange_strong(n, 0, std::memory_order_relaxed)) {
+            return;
+        }
+        uint64_t ticks = _window_overhead_ticks.exchange(0, std::memory_order_relaxed);
+        int64_t us = _window_request_us.exchange(0, std::memory_order_relaxed);
+        if (us <= 0) {
+            return;
+        }
+        double ratio = ticks * overhead::ns_per_tick() / (us * 1000.0);
+        double budget = _budget.load(std::memory_order_relaxed);
+        int level = _level.load(std::memory_order_relaxed);
+        if (ratio > budget && level < static_cast<int>(Level::kMinimal)) {
+            _level.store(level + 1, std::memory_order_relaxed);
+        } else if (ratio < budget / 2 && level > static_cast<int>(Level::kFull)) {
+            _level.store(level - 1, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<bool> _enabled{false};
+    std::atomic<double> _budget{0};
+    std::atomic<uint64_t> _window_requests{256};
+    std::atomic<int> _level{static_cast<int>(Level::kFull)};
+
+    std::atomic<uint64_t> _requests{0};
+    std::atomic<uint64_t> _overhead_ticks{0};
+    std::atomic<uint64_t> _request_ns{0};
+
+    std::atomic<uint64_t> _window_count{0};
+    std::atomic<uint64_t> _window_overhead_ticks{0};
+    std::atomic<int64_t> _window_request_us{0};
+};
+
+// 作用域内的耗时计入 counter，统计关闭时只多一次 relaxed load
+// 可以嵌套，只有线程上最外层的作用域计数
+// late 为 true 时同时计入 Overhead::add_late，用于请求结算之后的开销
+class OverheadScope {
+public:
+    explicit OverheadScope(OverheadCounter& counter, bool late = false) : OverheadScope(&counter, late) {}
+
+    // counter 为空时不计数
+    explicit OverheadScope(OverheadCounter* counter, bool late = false)
+        : _active(counter && Overhead::Instance().enabled()) {
+        if (_active && overhead::scope_depth++ == 0) {
+            _counter = counter;
+            _late = late;
+            _begin = overhead::now_ticks();
+        }
+    }
+
+    ~OverheadScope() {
+        if (!_active) {
+            return;
+        }
+        --overhead::scope_depth;
+        if (_counter) {
+            uint64_t ticks = overhead::now_ticks() - _begin;
+            _counter->add(ticks);
+            if (_late) {
+                Overhead::Instance().add_late(ticks);
+            }
+        }
+    }
+
+    OverheadScope(const OverheadScope &) = delete;
+    OverheadScope& operator=(const OverheadScope &) = delete;
+
+private:
+    bool _active;
+    bool _late = false;
+    OverheadCounter* _counter = nullptr;
+    uint64_t _begin = 0;
+};
+
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+namespace timekeeper {
+
+#ifdef __linux__
+
+// 每个线程一组硬件计数器：cycles、instructions、cache misses、branch misses
+// 用 perf_event_open 打开（只统计用户态），第一次使用时懒加载；
+// 内核允许时（cap_user_rdpmc）用 rdpmc 在用户态直接读，不进内核，否则退化为对 group leader 的一次 read()
+// perf 不可用（没有 PMU、权限不足、容器限制等）时 available() 返回 false，探针不产生数据
+class PerfCounters {
+public:
+    enum Counter {
+        kCycles = 0,
+        kInstructions,
+        kCacheMisses,
+        kBranchMisses,
+        kCounterNum,
+    };
+
+    struct Values {
+        uint64_t v[kCounterNum];
+    };
+
+    // disable copy, assignment
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters& operator=(const PerfCounters &) = delete;
+
+    // 当前线程的计数器
+    static PerfCounters& ThreadLocal() {
+        static thread_local PerfCounters counters;
+        return counters;
+    }
+
+    // 进程内是否已经确认 perf 不可用，避免每个线程都去尝试
+    static bool disabled() {
+        return process_disabled().load(std::memory_order_relaxed);
+    }
+
+    bool available() const { return _available; }
+
+    bool read(Values& out) {
+        if (!_available) {
+            return false;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        if (_use_rdpmc) {
+            for (int i = 0; i < kCounterNum; ++i) {
+                if (!read_rdpmc(_pages[i], out.v[i])) {
+                    return read_group(out);
+                }
+            }
+            return true;
+        }
+#endif
+        return read_group(out);
+    }
+
+    ~PerfCounters() {
+        for (int i = 0; i < kCounterNum; ++i) {
+            if (_pages[i]) {
+                ::munmap(_pages[i], page_size());
+            }
+            if (_fds[i] >= 0) {
+                ::close(_fds[i]);
+            }
+        }
+    }
+
+private:
+    PerfCounters() {
+        for (int i = 0; i < kCounterNum; ++i) {
+            _fds[i] = -1;
+            _pages[i] = nullptr;
+        }
+        if (disabled()) {
+            return;
+        }
+        static const uint64_t kConfigs[kCounterNum] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+        for (int i = 0; i < kCounterNum; ++i) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = kConfigs[i];
+            attr.disabled = i == 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            int fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : _fds[0], 0));
+            if (fd < 0) {
+                // 任何一个计数器打不开都视为不可用，整组一起放弃
+                process_disabled().store(true, std::memory_order_relaxed);
+                return;
+            }
+            _fds[i] = fd;
+        }
+
+        // 映射每个事件的元数据页，用于 rdpmc
+        _use_rdpmc = true;
+        for (int i = 0; i < kCounterNum; ++i) {
+            void* page = ::mmap(nullptr, page_size(), PROT_READ, MAP_SHARED, _fds[i], 0);
+            if (page == MAP_FAILED) {
+                _use_rdpmc = false;
+                continue;
+            }
+            _pages[i] = static_cast<struct perf_event_mmap_page*>(page);
+        }
+
+        ::ioctl(_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ::ioctl(_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        _available = true;
+
+        Values values;
+        if (_use_rdpmc) {
+            for (int i = 0; i < kCounterNum && _use_rdpmc; ++i) {
+                _use_rdpmc = _pages[i] && read_rdpmc(_pages[i], values.v[i]);
+            }
+        }
+    }
+
+    static std::atomic<bool>& process_disabled() {
+        static std::atomic<bool> flag{false};
+        return flag;
+    }
+
+    static size_t page_size() {
+        static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        return size;
+    }
+
+    bool read_group(Values& out) {
+        // PERF_FORMAT_GROUP: nr, values[nr]
+        uint64_t buffer[1 + kCounterNum];
+        if (::read(_fds[0], buffer, sizeof(buffer)) != static_cast<ssize_t>(sizeof(buffer))
+                || buffer[0] != kCounterNum) {
+            return false;
+        }
+        for (int i = 0; i < kCounterNum; ++i) {
+            out.v[i] = buffer[i + 1];
+        }
+        return true;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    static uint64_t rdpmc(uint32_t counter) {
+        uint32_t low, high;
+        __asm__ volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(counter));
+        return static_cast<uint64_t>(high) << 32 | low;
+    }
+
+    // 按 perf_event_mmap_page 注释里的协议读取，lock 变化时重试
+    static bool read_rdpmc(const volatile struct perf_event_mmap_page* page, uint64_t& out) {
+        uint32_t seq;
+        uint64_t count;
+        do {
+            seq = page->lock;
+            __asm__ volatile("" ::: "memory");
+            uint32_t idx = page->index;
+            if (!page->cap_user_rdpmc || idx == 0) {
+                return false;
+            }
+            count = page->offset;
+            uint16_t width = page->pmc_width;
+            int64_t pmc = static_cast<int64_t>(rdpmc(idx - 1));
+            pmc <<= 64 - width;
+            pmc >>= 64 - width;
+            count += pmc;
+            __asm__ volatile("" ::: "memory");
+        } while (page->lock != seq);
+        out = count;
+        return true;
+    }
+#else
+    static bool read_rdpmc(const volatile struct perf_event_mmap_page*, uint64_t&) {
+        return false;
+    }
+#endif
+
+    int _fds[kCounterNum];
+    struct perf_event_mmap_page* _pages[kCounterNum];
+    bool _available = false;
+    bool _use_rdpmc = false;
+};
+
+#else
+
+// 非 Linux 平台没有 perf_event_open，接口保持一致，永远不可用
+class PerfCounters {
+public:
+    enum Counter {
+        kCycles = 0,
+        kInstructions,
+        kCacheMisses,
+        kBranchMisses,
+        kCounterNum,
+    };
+
+    struct Values {
+        uint64_t v[kCounterNum];
+    };
+
+    // disable copy, assignment
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters& operator=(const PerfCounters &) = delete;
+
+    static PerfCounters& ThreadLocal() {
+        static thread_local PerfCounters counters;
+        return counters;
+    }
+
+    static bool disabled() { return true; }
+    bool available() const { return false; }
+    bool read(Values&) { return false; }
+
+private:
+    PerfCounters() {}
+};
+
+#endif
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+#include <time.h>
+
+#include <cstdint>
+#include <thread>
+
+#include "timekeeper/perf_counters.hpp"
+#include "timekeeper/record.hpp"
+
+namespace timekeeper {
+
+// span 的可选探针，按位组合，通过 TimeCounter::set_probes 或 add_recorder 的参数打开
+// 探针在 start/end 各采样一次，差值作为 span 的附加指标
+// perf 和 rusage 只在 Linux 上实现，CPU 时间需要 CLOCK_THREAD_CPUTIME_ID；平台不支持的探针静默跳过
+enum Probe : uint32_t {
+    kProbeNone = 0,
+    // 线程 CPU 时间，clock_gettime(CLOCK_THREAD_CPUTIME_ID)，纳秒精度
+    // Linux 上线程 CPU 时钟没有 vDSO 实现，每次采样是一次轻量系统调用（约 100~300ns）
+    kProbeCpuTime = 1u << 0,
+    // 硬件计数器：cycles、instructions、cache misses、branch misses，见 PerfCounters
+    // perf 不可用时静默跳过
+    kProbePerf = 1u << 1,
+    // getrusage(RUSAGE_THREAD) 里的自愿/非自愿上下文切换和缺页次数，
+    // 用来区分延迟是调度造成的还是工作本身
+    kProbeRusage = 1u << 2,
+    // 堆分配的字节数和次数，只算这条记录自己（不含嵌套在里面的、同样打开了该探针的记录）
+    // 需要链接 timekeeper_alloc 目标，见 alloc_tracker.hpp
+    kProbeAlloc = 1u << 3,
+};
+
+// 一次采样的结果
+struct ProbeSnapshot {
+    std::thread::id tid;
+    int64_t cpu_ns = -1;
+    bool perf_valid = false;
+    PerfCounters::Values perf;
+    bool rusage_valid = false;
+#ifdef __linux__
+    struct rusage usage;
+#endif
+
+    void take(uint32_t probes) {
+        tid = std::this_thread::get_id();
+        if ((probes & kProbePerf) && !PerfCounters::disabled()) {
+            perf_valid = PerfCounters::ThreadLocal().read(perf);
+        }
+#ifdef __linux__
+        if (probes & kProbeRusage) {
+            rusage_valid = getrusage(RUSAGE_THREAD, &usage) == 0;
+        }
+#endif
+#ifdef CLOCK_THREAD_CPUTIME_ID
+        if (probes & kProbeCpuTime) {
+            struct timespec ts;
+            cpu_ns = clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0
+                ? static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec : -1;
+        }
+#endif
+    }
+
+    // 计算 begin 到 end 的差值，写入 metrics
+    // 线程相关的指标要求 start 和 end 在同一个线程采样，否则丢弃
+    static void diff(const ProbeSnapshot& begin, const ProbeSnapshot& end,
+            int64_t wall_us, SpanMetrics& metrics) {
+        if (begin.tid != end.tid) {
+            return;
+        }
+        if (begin.cpu_ns >= 0 && end.cpu_ns >= begin.cpu_ns) {
+            metrics.cpu_us = (end.cpu_ns - begin.cpu_ns) / 1000;
+            metrics.cpu_wall_us = wall_us;
+        }
+        if (begin.perf_valid && end.perf_valid) {
+            metrics.cycles = static_cast<int64_t>(end.perf.v[PerfCounters::kCycles] - begin.perf.v[PerfCounters::kCycles]);
+            metrics.instructions = static_cast<int64_t>(
+                    end.perf.v[PerfCounters::kInstructions] - begin.perf.v[PerfCounters::kInstructions]);
+            metrics.cache_misses = static_cast<int64_t>(
+                    end.perf.v[PerfCounters::kCacheMisses] - begin.perf.v[PerfCounters::kCacheMisses]);
+            metrics.branch_misses = static_cast<int64_t>(
+                    end.perf.v[PerfCounters::kBranchMisses] - begin.perf.v[PerfCounters::kBranchMisses]);
+        }
+#ifdef __linux__
+        if (begin.rusage_valid && end.rusage_valid) {
+            metrics.voluntary_switches = end.usage.ru_nvcsw - begin.usage.ru_nvcsw;
+            metrics.involuntary_switches = end.usage.ru_nivcsw - begin.usage.ru_nivcsw;
+            metrics.minor_faults = end.usage.ru_minflt - begin.usage.ru_minflt;
+            metrics.major_faults = end.usage.ru_majflt - begin.usage.ru_majflt;
+        }
+#endif
+    }
+};
+
+}
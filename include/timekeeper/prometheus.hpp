@@ -0,0 +1,134 @@
+#pragma once
+
+#include <charconv>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "timekeeper/span_stats.hpp"
+
+namespace timekeeper {
+
+// 把 SpanStats 渲染成 Prometheus text exposition format（0.0.4）
+// 每个 span 名字一个 histogram series，单位是秒：
+//   timekeeper_span_duration_seconds_bucket{span="step1",le="0.000512"} 10
+//   timekeeper_span_duration_seconds_sum{span="step1"} 0.004096
+//   timekeeper_span_duration_seconds_count{span="step1"} 10
+// le 标签和每个 series 的标签前缀都只生成一次，之后的抓取只做整数格式化和追加，
+// 输出写进复用的缓冲区
+class PrometheusExporter {
+public:
+    // disable copy, assignment, move
+    PrometheusExporter(const PrometheusExporter &) = delete;
+    PrometheusExporter& operator=(const PrometheusExporter &) = delete;
+    PrometheusExporter(PrometheusExporter &&) = delete;
+
+    explicit PrometheusExporter(SpanStats& stats = SpanStats::Instance(),
+            std::string metric = "timekeeper_span_duration_seconds")
+        : _stats(stats), _metric(std::move(metric)) {
+        for (size_t i = 0; i < kLatencyBuckets; ++i) {
+            if (i + 1 == kLatencyBuckets) {
+                _le[i] = "+Inf";
+            } else {
+                _le[i] = seconds_text(latency_bucket_bound(i));
+            }
+        }
+    }
+
+    // 渲染全部 series，返回的引用在下一次 render 之前有效
+    const std::string& render() {
+        std::lock_guard lock(_mtx);
+        _buffer.clear();
+        _buffer += "# HELP ";
+        _buffer += _metric;
+        _buffer += " Duration of timekeeper spans.\n# TYPE ";
+        _buffer += _metric;
+        _buffer += " histogram\n";
+
+        _stats.for_each([this](const SpanStats::Snapshot& s) {
+            const Series& series = get_series(s.name);
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < kLatencyBuckets; ++i) {
+                cumulative += s.buckets[i];
+                _buffer += series.bucket_prefix;
+                _buffer += _le[i];
+                _buffer += "\"} ";
+                append_uint(cumulative);
+                _buffer += '\n';
+            }
+            _buffer += series.sum_prefix;
+            char buffer[32];
+            int n = snprintf(buffer, sizeof(buffer), "%.6f", s.sum_us / 1e6);
+            _buffer.append(buffer, n);
+            _buffer += '\n';
+            // 桶和 count 是分别读取的，并发 record 时可能对不上；_count 用桶的累计值，保证和 le="+Inf" 相等
+            _buffer += series.count_prefix;
+            append_uint(cumulative);
+            _buffer += '\n';
+        });
+        return _buffer;
+    }
+
+private:
+    // 微秒数转换成秒的精确十进制文本，例如 4194304 -> "4.194304"，1 -> "0.000001"
+    static std::string seconds_text(int64_t us) {
+        char buffer[32];
+        int n = snprintf(buffer, sizeof(buffer), "%lld.%06lld",
+                static_cast<long long>(us / 1000000), static_cast<long long>(us % 1000000));
+        while (n > 0 && buffer[n - 1] == '0') {
+            --n;
+        }
+        if (n > 0 && buffer[n - 1] == '.') {
+            --n;
+        }
+        return std::string(buffer, n);
+    }
+
+    // 每个 span 名字预先拼好的标签前缀
+    struct Series {
+        std::string bucket_prefix;  // name_bucket{span="x",le="
+        std::string sum_prefix;     // name_sum{span="x"}
+        std::string count_prefix;   // name_count{span="x"}
+    };
+
+    const Series& get_series(const std::string& name) {
+        auto it = _series.find(name);
+        if (it != _series.end()) {
+            return it->second;
+        }
+        std::string label = "{span=\"";
+        for (char c : name) {
+            switch (c) {
+                case '\\': label += "\\\\"; break;
+                case '"': label += "\\\""; break;
+                case '\n': label += "\\n"; break;
+                default: label += c;
+            }
+        }
+        label += '"';
+
+        Series series;
+        series.bucket_prefix = _metric + "_bucket" + label + ",le=\"";
+        series.sum_prefix = _metric + "_sum" + label + "} ";
+        series.count_prefix = _metric + "_count" + label + "} ";
+        return _series.emplace(name, std::move(series)).first->second;
+    }
+
+    void append_uint(uint64_t v) {
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), v);
+        _buffer.append(buffer, result.ptr - buffer);
+    }
+
+    SpanStats& _stats;
+    std::string _metric;
+    std::string _le[kLatencyBuckets];
+
+    std::mutex _mtx;
+    std::string _buffer;
+    std::unordered_map<std::string, Series> _series;
+};
+
+}
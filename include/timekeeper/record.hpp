@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "timekeeper/log_fields.hpp"
+
+namespace timekeeper {
+
+// span 的附加指标，由探针采集（见 probes.hpp），没有采集的指标为 -1
+// 同名 span 合并时各项指标累加
+struct SpanMetrics {
+    int64_t cpu_us = -1;       // 线程 CPU 时间
+    int64_t cpu_wall_us = 0;   // 采集到 CPU 时间的那些记录的墙上时间之和，用来算 off-cpu
+    int64_t cycles = -1;       // 以下为硬件计数器，只统计用户态
+    int64_t instructions = -1;
+    int64_t cache_misses = -1;
+    int64_t branch_misses = -1;
+    int64_t voluntary_switches = -1;     // 自愿上下文切换（阻塞、sleep、等锁）
+    int64_t involuntary_switches = -1;   // 非自愿上下文切换（时间片用完被抢占）
+    int64_t minor_faults = -1;
+    int64_t major_faults = -1;           // 需要读盘的缺页
+    int64_t alloc_bytes = -1;            // 堆分配字节数（不扣除释放）
+    int64_t alloc_count = -1;
+    int64_t active_us = -1;              // 协程 span 实际运行的时间，不含挂起
+    int64_t active_wall_us = 0;          // 采集到 active_us 的那些记录的墙上时间之和，用来算挂起时间
+
+    static void add(int64_t& target, int64_t v) {
+        if (v >= 0) {
+            target = target < 0 ? v : target + v;
+        }
+    }
+
+    void merge(const SpanMetrics& other) {
+        add(cpu_us, other.cpu_us);
+        cpu_wall_us += other.cpu_wall_us;
+        add(cycles, other.cycles);
+        add(instructions, other.instructions);
+        add(cache_misses, other.cache_misses);
+        add(branch_misses, other.branch_misses);
+        add(voluntary_switches, other.voluntary_switches);
+        add(involuntary_switches, other.involuntary_switches);
+        add(minor_faults, other.minor_faults);
+        add(major_faults, other.major_faults);
+        add(alloc_bytes, other.alloc_bytes);
+        add(alloc_count, other.alloc_count);
+        add(active_us, other.active_us);
+        active_wall_us += other.active_wall_us;
+    }
+
+    bool empty() const {
+        return cpu_us < 0 && cycles < 0 && voluntary_switches < 0 && alloc_bytes < 0 && active_us < 0;
+    }
+
+    // 遍历已采集的指标，f(std::string_view name, int64_t value)，供导出器使用
+    template <typename F>
+    void for_each(F&& f) const {
+        if (cpu_us >= 0) {
+            f("cpu_us", cpu_us);
+            f("off_cpu_us", std::max<int64_t>(cpu_wall_us - cpu_us, 0));
+        }
+        if (cycles >= 0) {
+            f("cycles", cycles);
+            f("instructions", instructions);
+            f("cache_misses", cache_misses);
+            f("branch_misses", branch_misses);
+        }
+        if (voluntary_switches >= 0) {
+            f("voluntary_switches", voluntary_switches);
+            f("involuntary_switches", involuntary_switches);
+            f("minor_faults", minor_faults);
+            f("major_faults", major_faults);
+        }
+        if (alloc_bytes >= 0) {
+            f("alloc_bytes", alloc_bytes);
+            f("alloc_count", alloc_count);
+        }
+        if (active_us >= 0) {
+            f("active_us", active_us);
+            f("suspended_us", std::max<int64_t>(active_wall_us - active_us, 0));
+        }
+    }
+};
+
+// 一个 span 的结构化数据，同名的记录已经合并
+struct SpanRecord {
+    std::string name;
+    int64_t start_us;
+    int64_t end_us;
+    SpanMetrics metrics = {};
+    bool in_progress = false;   // 快照时还没结束的记录，end_us 是快照的时刻
+};
+
+// 一个请求结束时的结构化数据，交给异步输出/导出器使用，格式化推迟到消费方
+struct RequestRecord {
+    std::string logid;
+    std::vector<std::pair<std::string, LogValue>> fields;  // 已按 key 排序
+    std::vector<SpanRecord> spans;                          // 已按 name 排序
+};
+
+// 附加指标的文本格式，例如 " cpu: 1.000(ms) off-cpu: 2.000(ms)"
+// 硬件计数器输出 IPC 和每千条指令的 miss 数（MPKI），rusage 输出上下文切换和缺页次数，
+// 堆分配输出 "alloc: 字节数(B)/次数"，协程 span 输出运行和挂起的时间
+inline void append_metrics_text(std::string& out, const SpanMetrics& metrics) {
+    char buffer[128];
+    if (metrics.cpu_us >= 0) {
+        int n = snprintf(buffer, sizeof(buffer), " cpu: %.3f(ms) off-cpu: %.3f(ms)",
+                metrics.cpu_us / 1000.0,
+                std::max<int64_t>(metrics.cpu_wall_us - metrics.cpu_us, 0) / 1000.0);
+        out.append(buffer, n);
+    }
+    if (metrics.cycles >= 0) {
+        double kilo_instructions = metrics.instructions > 0 ? metrics.instructions / 1000.0 : 1.0;
+        int n = snprintf(buffer, sizeof(buffer), " cycles: %lld ipc: %.2f cache-mpki: %.2f branch-mpki: %.2f",
+                static_cast<long long>(metrics.cycles),
+                metrics.cycles > 0 ? static_cast<double>(metrics.instructions) / metrics.cycles : 0.0,
+                metrics.cache_misses / kilo_instructions,
+                metrics.branch_misses / kilo_instructions);
+        out.append(buffer, n);
+    }
+    if (metrics.voluntary_switches >= 0) {
+        int n = snprintf(buffer, sizeof(buffer), " vcsw: %lld ivcsw: %lld minflt: %lld majflt: %lld",
+                static_cast<long long>(metrics.voluntary_switches),
+                static_cast<long long>(metrics.involuntary_switches),
+                static_cast<long long>(metrics.minor_faults),
+                static_cast<long long>(metrics.major_faults));
+        out.append(buffer, n);
+    }
+    if (metrics.alloc_bytes >= 0) {
+        int n = snprintf(buffer, sizeof(buffer), " alloc: %lld(B)/%lld",
+                static_cast<long long>(metrics.alloc_bytes),
+                static_cast<long long>(metrics.alloc_count));
+        out.append(buffer, n);
+    }
+    if (metrics.active_us >= 0) {
+        int n = snprintf(buffer, sizeof(buffer), " active: %.3f(ms) suspended: %.3f(ms)",
+                metrics.active_us / 1000.0,
+                std::max<int64_t>(metrics.active_wall_us - metrics.active_us, 0) / 1000.0);
+        out.append(buffer, n);
+    }
+}
+
+// 格式化 span 列表，格式与 TimeCounter::report 一致
+inline void append_spans_text(std::string& out, const std::vector<SpanRecord>& spans) {
+    char buffer[100];
+    for (size_t i = 0; i < spans.size(); ++i) {
+        int n = snprintf(buffer, sizeof(buffer), "[%s: %.3f(ms)",
+                spans[i].name.c_str(),
+                (spans[i].end_us - spans[i].start_us) / 1000.0);
+        if (n < 0) {
+            continue;
+        }
+        if (i > 0) {
+            out += ' ';
+        }
+        // 名字过长时 snprintf 会截断，保持和原先一致
+        out.append(buffer, std::min<size_t>(n, sizeof(buffer) - 1));
+        append_metrics_text(out, spans[i].metrics);
+        if (spans[i].in_progress) {
+            out += " running";
+        }
+        out += ']';
+    }
+}
+
+// 格式化整个请求，格式与 ThreadData::report 一致
+inline void append_record_text(std::string& out, const RequestRecord& record) {
+    out += "[logid: ";
+    out += record.logid;
+    out += ']';
+    for (auto& field : record.fields) {
+        out += " [";
+        out += field.first;
+        out += ": ";
+        field.second.append_to(out);
+        out += ']';
+    }
+    out += ' ';
+    append_spans_text(out, record.spans);
+}
+
+inline std::string format_record(const RequestRecord& record) {
+    std::string out;
+    append_record_text(out, record);
+    return out;
+}
+
+// 把一批记录格式化到输出缓冲区，由 AsyncEmitter 在后台线程调用
+// begin_batch/end_batch 用于需要整批包装的格式（如 OTLP 的一个 export 请求）
+class RecordFormatter {
+public:
+    virtual ~RecordFormatter() = default;
+
+    virtual void begin_batch(std::string& /*out*/) {}
+    virtual void append(std::string& out, const RequestRecord& record) = 0;
+    virtual void end_batch(std::string& /*out*/) {}
+};
+
+// 文本格式，每条记录一行，与 ThreadData::report 一致
+class TextFormatter : public RecordFormatter {
+public:
+    void append(std::string& out, const RequestRecord& record) override {
+        append_record_text(out, record);
+        out += '\n';
+    }
+};
+
+}
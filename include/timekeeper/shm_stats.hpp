@@ -0,0 +1,281 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "timekeeper/span_stats.hpp"
+
+namespace timekeeper {
+
+// 共享内存里的统计段，固定布局，外部进程（如 timekeeper-top）只读挂载
+// 写方用 seqlock 保护：写之前 seq 变成奇数，写完变成偶数；
+// 读方读到奇数或者前后 seq 不一致时重试。进程本身只做内存拷贝，不做格式化和 IO
+namespace shm {
+
+constexpr uint64_t kMagic = 0x314d48535045454bULL;  // "KEEPSHM1"
+constexpr uint32_t kVersion = 1;
+constexpr size_t kNameSize = 64;
+
+struct Slot {
+    char name[kNameSize];  // 以 '\0' 结尾，超长会截断
+    uint64_t count;
+    uint64_t sum_us;
+    int64_t min_us;
+    int64_t max_us;
+    uint64_t buckets[kLatencyBuckets];
+};
+
+struct Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t capacity;              // slot 个数
+    std::atomic<uint64_t> seq;
+    int64_t pid;
+    int64_t updated_us;             // 最近一次发布的时间（system_clock）
+    uint32_t count;                 // 有效 slot 个数
+    uint32_t bucket_count;          // 等于 kLatencyBuckets
+    uint64_t dropped;               // 超出 capacity 没能发布的 span 名字个数
+};
+
+inline size_t segment_size(uint32_t capacity) {
+    return sizeof(Header) + sizeof(Slot) * capacity;
+}
+
+inline Slot* slots(Header* header) {
+    return reinterpret_cast<Slot*>(header + 1);
+}
+
+}  // namespace shm
+
+// 把 SpanStats 发布到共享内存段
+class ShmStatsPublisher {
+public:
+    // disable copy, assignment, move
+    ShmStatsPublisher(const ShmStatsPublisher &) = delete;
+    ShmStatsPublisher& operator=(const ShmStatsPublisher &) = delete;
+    ShmStatsPublisher(ShmStatsPublisher &&) = delete;
+
+    // name 是 shm_open 的名字，例如 "/timekeeper_stats"
+    explicit ShmStatsPublisher(const std::string& name, uint32_t capacity = 256,
+            SpanStats& stats = SpanStats::Instance())
+        : _name(name), _capacity(capacity), _stats(stats) {
+        int fd = ::shm_open(_name.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd < 0) {
+            std::cerr << "shm_open failed, name: " << _name << ", error: " << strerror(errno) << std::endl;
+            return;
+        }
+        _size = shm::segment_size(_capacity);
+        if (::ftruncate(fd, _size) != 0) {
+            std::cerr << "ftruncate shm failed, name: " << _name << ", error: " << strerror(errno) << std::endl;
+            ::close(fd);
+            return;
+        }
+        void* addr = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            std::cerr << "mmap shm failed, name: " << _name << ", error: " << strerror(errno) << std::endl;
+            return;
+        }
+        _header = static_cast<shm::Header*>(addr);
+        memset(addr, 0, _size);
+        _header->version = shm::kVersion;
+        _header->capacity = _capacity;
+        _header->pid = ::getpid();
+        _header->bucket_count = kLatencyBuckets;
+        // magic 最后写，读方看到 magic 说明布局已经初始化
+        std::atomic_thread_fence(std::memory_order_release);
+        _header->magic = shm::kMagic;
+    }
+
+    // 析构时停止后台线程并删除共享内存段
+    ~ShmStatsPublisher() {
+        stop();
+        if (_header) {
+            ::munmap(_header, _size);
+            ::shm_unlink(_name.c_str());
+        }
+    }
+
+    bool ok() const { return _header != nullptr; }
+
+    // 把当前的统计拷贝进共享内存
+    void publish() {
+        if (!_header) {
+            return;
+        }
+        std::lock_guard lock(_mtx);
+
+        // 先在本地拼好，再在 seqlock 里一次拷贝，缩短写临界区
+        _staging.clear();
+        uint64_t dropped = 0;
+        _stats.for_each([&](const SpanStats::Snapshot& s) {
+            if (_staging.size() >= _capacity) {
+                ++dropped;
+                return;
+            }
+            shm::Slot slot;
+            memset(slot.name, 0, sizeof(slot.name));
+            memcpy(slot.name, s.name.data(), std::min(s.name.size(), shm::kNameSize - 1));
+            slot.count = s.count;
+            slot.sum_us = s.sum_us;
+            slot.min_us = s.count ? s.min_us : 0;
+            slot.max_us = s.max_us;
+            memcpy(slot.buckets, s.buckets, sizeof(slot.buckets));
+            _staging.push_back(slot);
+        });
+
+        uint64_t seq = _header->seq.load(std::memory_order_relaxed);
+        _header->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        memcpy(shm::slots(_header), _staging.data(), _staging.size() * sizeof(shm::Slot));
+        _header->count = static_cast<uint32_t>(_staging.size());
+        _header->dropped = dropped;
+        _header->updated_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+
+        _header->seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // 启动后台线程，按 interval 周期发布
+    void start(std::chrono::milliseconds interval = std::chrono::milliseconds(1000)) {
+        std::lock_guard lock(_thread_mtx);
+        if (_thread.joinable()) {
+            return;
+        }
+        _stop = false;
+        _thread = std::thread([this, interval] {
+            std::unique_lock lock(_thread_mtx);
+            while (!_stop) {
+                lock.unlock();
+                publish();
+                lock.lock();
+                _cv.wait_for(lock, interval, [this] { return _stop; });
+            }
+        });
+    }
+
+    void stop() {
+        {
+            std::lock_guard lock(_thread_mtx);
+            _stop = true;
+        }
+        _cv.notify_all();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+private:
+    std::string _name;
+    uint32_t _capacity;
+    SpanStats& _stats;
+    size_t _size = 0;
+    shm::Header* _header = nullptr;
+
+    std::mutex _mtx;
+    std::vector<shm::Slot> _staging;
+
+    std::mutex _thread_mtx;
+    std::condition_variable _cv;
+    bool _stop = false;
+    std::thread _thread;
+};
+
+// 只读挂载共享内存段
+class ShmStatsReader {
+public:
+    struct Snapshot {
+        int64_t pid = 0;
+        int64_t updated_us = 0;
+        uint64_t dropped = 0;
+        std::vector<shm::Slot> slots;
+    };
+
+    // disable copy, assignment, move
+    ShmStatsReader(const ShmStatsReader &) = delete;
+    ShmStatsReader& operator=(const ShmStatsReader &) = delete;
+    ShmStatsReader(ShmStatsReader &&) = delete;
+
+    explicit ShmStatsReader(const std::string& name) {
+        int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(shm::Header)) {
+            ::close(fd);
+            return;
+        }
+        void* addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            return;
+        }
+        auto header = static_cast<const shm::Header*>(addr);
+        if (header->magic != shm::kMagic || header->version != shm::kVersion
+                || header->bucket_count != kLatencyBuckets
+                || shm::segment_size(header->capacity) > static_cast<size_t>(st.st_size)) {
+            ::munmap(addr, st.st_size);
+            return;
+        }
+        _header = header;
+        _size = st.st_size;
+    }
+
+    ~ShmStatsReader() {
+        if (_header) {
+            ::munmap(const_cast<shm::Header*>(_header), _size);
+        }
+    }
+
+    bool ok() const { return _header != nullptr; }
+
+    // 读一份一致的快照，写方一直在写导致重试超过 max_retries 次时返回 false
+    bool read(Snapshot& out, int max_retries = 100) const {
+        if (!_header) {
+            return false;
+        }
+        auto slots = shm::slots(const_cast<shm::Header*>(_header));
+        for (int i = 0; i < max_retries; ++i) {
+            uint64_t begin = _header->seq.load(std::memory_order_acquire);
+            if (begin & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t count = std::min(_header->count, _header->capacity);
+            out.pid = _header->pid;
+            out.updated_us = _header->updated_us;
+            out.dropped = _header->dropped;
+            out.slots.resize(count);
+            memcpy(out.slots.data(), slots, count * sizeof(shm::Slot));
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_header->seq.load(std::memory_order_relaxed) == begin) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    const shm::Header* _header = nullptr;
+    size_t _size = 0;
+};
+
+}
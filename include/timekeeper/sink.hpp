@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdio>
+#include <mutex>
+#include <string_view>
+
+namespace timekeeper {
+
+// 输出目标的抽象，AsyncEmitter 把格式化好的一批记录交给 Sink
+// 实现需要保证线程安全
+class Sink {
+public:
+    virtual ~Sink() = default;
+
+    // 写入一段数据，可以只写进缓冲区
+    virtual void write(std::string_view data) = 0;
+
+    // 把缓冲区里的数据全部落盘
+    virtual void flush() = 0;
+
+    // 周期性调用，用于检查按时间触发的刷盘/切分，默认什么都不做
+    virtual void poll() {}
+};
+
+// 写到 FILE*，默认是 stdout
+class StreamSink : public Sink {
+public:
+    explicit StreamSink(FILE* fp = stdout) : _fp(fp) {}
+
+    void write(std::string_view data) override {
+        std::lock_guard lock(_mtx);
+        fwrite(data.data(), 1, data.size(), _fp);
+        fflush(_fp);
+    }
+
+    void flush() override {
+        std::lock_guard lock(_mtx);
+        fflush(_fp);
+    }
+
+private:
+    std::mutex _mtx;
+    FILE* _fp;
+};
+
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+namespace timekeeper {
+
+// 耗时直方图的桶：第 i 个桶包含 (2^(i-1), 2^i] 微秒，第 0 个桶包含 <= 1us，最后一个桶是 +Inf
+constexpr size_t kLatencyBuckets = 28;
+
+inline size_t latency_bucket(int64_t us) {
+    if (us <= 1) {
+        return 0;
+    }
+    size_t idx = 64 - __builtin_clzll(static_cast<uint64_t>(us - 1));
+    return idx < kLatencyBuckets - 1 ? idx : kLatencyBuckets - 1;
+}
+
+// 第 i 个桶的上界（包含），最后一个桶返回 INT64_MAX
+inline int64_t latency_bucket_bound(size_t idx) {
+    return idx + 1 < kLatencyBuckets ? (int64_t(1) << idx) : INT64_MAX;
+}
+
+// 根据直方图估算分位数，返回所在桶的上界，不超过观测到的最大值 max_us
+inline int64_t estimate_quantile(const uint64_t* buckets, double q, int64_t max_us = INT64_MAX) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < kLatencyBuckets; ++i) {
+        total += buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kLatencyBuckets; ++i) {
+        seen += buckets[i];
+        if (seen > rank) {
+            return std::min(latency_bucket_bound(i), max_us);
+        }
+    }
+    return std::min(latency_bucket_bound(kLatencyBuckets - 1), max_us);
+}
+
+// 按 span 名字聚合的进程级耗时统计，由 TimeCounter 在记录上传时写入
+// 默认关闭；打开后每次上传多一次读锁下的查找和几次原子加
+class SpanStats {
+public:
+    struct Entry {
+        std::string name;
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum_us{0};
+        std::atomic<int64_t> min_us{INT64_MAX};
+        std::atomic<int64_t> max_us{0};
+        std::atomic<uint64_t> buckets[kLatencyBuckets] = {};
+    };
+
+    // 拷贝出来的快照
+    struct Snapshot {
+        std::string name;
+        uint64_t count;
+        uint64_t sum_us;
+        int64_t min_us;
+        int64_t max_us;
+        uint64_t buckets[kLatencyBuckets];
+    };
+
+    // disable copy, assignment, move
+    SpanStats(const SpanStats &) = delete;
+    SpanStats& operator=(const SpanStats &) = delete;
+    SpanStats(SpanStats &&) = delete;
+
+    SpanStats() {}
+
+    static SpanStats& Instance() {
+        static SpanStats instance;
+        return instance;
+    }
+
+    void set_enabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+    bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    void record(std::string_view name, int64_t duration_us) {
+        if (duration_us < 0) {
+            duration_us = 0;
+        }
+        Entry& entry = get_or_create(name);
+        entry.count.fetch_add(1, std::memory_order_relaxed);
+        entry.sum_us.fetch_add(duration_us, std::memory_order_relaxed);
+        entry.buckets[latency_bucket(duration_us)].fetch_add(1, std::memory_order_relaxed);
+        update_min(entry.min_us, duration_us);
+        update_max(entry.max_us, duration_us);
+    }
+
+    // 按名字顺序遍历，f(const Snapshot&)
+    template <typename F>
+    void for_each(F&& f) const {
+        Snapshot snapshot;
+        std::shared_lock lock(_mtx);
+        for (auto& item : _entries) {
+            const Entry& entry = *item.second;
+            snapshot.name = entry.name;
+            snapshot.count = entry.count.load(std::memory_order_relaxed);
+            snapshot.sum_us = entry.sum_us.load(std::memory_order_relaxed);
+            snapshot.min_us = entry.min_us.load(std::memory_order_relaxed);
+            snapshot.max_us = entry.max_us.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < kLatencyBuckets; ++i) {
+                snapshot.buckets[i] = entry.buckets[i].load(std::memory_order_relaxed);
+            }
+            f(snapshot);
+        }
+    }
+
+    size_t size() const {
+        std::shared_lock lock(_mtx);
+        return _entries.size();
+    }
+
+private:
+    Entry& get_or_create(std::string_view name) {
+        {
+            std::shared_lock lock(_mtx);
+            auto it = _entries.find(name);
+            if (it != _entries.end()) {
+                return *it->second;
+            }
+        }
+        std::unique_lock lock(_mtx);
+        auto it = _entries.find(name);
+        if (it == _entries.end()) {
+            auto entry = std::make_unique<Entry>();
+            entry->name = std::string(name);
+            it = _entries.emplace(entry->name, std::move(entry)).first;
+        }
+        return *it->second;
+    }
+
+    static void update_min(std::atomic<int64_t>& target, int64_t v) {
+        int64_t cur = target.load(std::memory_order_relaxed);
+        while (v < cur && !target.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    static void update_max(std::atomic<int64_t>& target, int64_t v) {
+        int64_t cur = target.load(std::memory_order_relaxed);
+        while (v > cur && !target.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    std::atomic<bool> _enabled{false};
+    mutable std::shared_mutex _mtx;
+    // std::less<> 支持用 string_view 查找，热路径上不构造 std::string
+    std::map<std::string, std::unique_ptr<Entry>, std::less<>> _entries;
+};
+
+}
@@ -3,8 +3,21 @@
 #include <string>
 #include <functional>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "timekeeper/alloc_tracker.hpp"
+#include "timekeeper/binary_format.hpp"
+#include "timekeeper/overhead.hpp"
+#include "timekeeper/probes.hpp"
+#include "timekeeper/record.hpp"
+#include "timekeeper/span_stats.hpp"
 
 namespace timekeeper {
 
@@ -16,15 +29,35 @@ public:
     TimeRecorder(const TimeRecorder &) = delete;
     TimeRecorder& operator=(const TimeRecorder &) = delete;
 
-    using CB = std::function<void(const std::string &name, int64_t start_us, int64_t end_us)>;
-    explicit TimeRecorder(const std::string &name, CB cb) : _name(name), _cb(cb) {
+    // 上传的数据：起止时间和探针采集的指标
+    struct Sample {
+        int64_t start_us;
+        int64_t end_us;
+        SpanMetrics metrics;
+    };
+
+    using CB = std::function<void(const std::string &name, const Sample &sample)>;
+    // overhead 非空时，start/end 里的探针采集和上传计入它，见 Overhead
+    explicit TimeRecorder(const std::string &name, CB cb, uint32_t probes = kProbeNone,
+            OverheadCounter *overhead = nullptr)
+        : _name(name), _cb(cb), _probes(probes), _overhead(overhead) {
+        alloc::SuppressScope alloc_suppress;
         _create_at = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
         _is_start = false;
         _is_end = false;
         _uploaded = false;
+        if (_probes) {
+            _probe_state = std::make_unique<ProbeState>();
+            _probe_state->begin.take(_probes);
+        }
+        if (_probes & kProbeAlloc) {
+            _probe_state->alloc_scope.begin();
+        }
     }
 
     ~TimeRecorder() {
+        OverheadScope overhead_scope(_overhead);
+        alloc::SuppressScope alloc_suppress;
         std::lock_guard lock(_mtx);
         upload();
     }
@@ -36,19 +69,45 @@ public:
     }
 
     void start() {
+        OverheadScope overhead_scope(_overhead);
+        alloc::SuppressScope alloc_suppress;
         std::lock_guard lock(_mtx);
         if (_is_end || _is_start) {
             return;
         }
         _start_at = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
         _is_start = true;
+        if (_probes) {
+            _probe_state->begin.take(_probes);
+        }
+        if (_probes & kProbeAlloc) {
+            _probe_state->alloc_scope.begin();
+        }
+    }
+
+    // 未上传的记录到 now_us 为止的进度，不结束记录，不采集探针；已经上传时返回 false
+    bool peek(int64_t now_us, SpanRecord &out) {
+        std::lock_guard lock(_mtx);
+        if (_uploaded) {
+            return false;
+        }
+        out.name = _name;
+        out.start_us = _is_start ? _start_at : _create_at;
+        out.end_us = std::max(now_us, out.start_us);
+        out.in_progress = true;
+        return true;
     }
 
     void end() {
+        OverheadScope overhead_scope(_overhead);
+        alloc::SuppressScope alloc_suppress;
         std::lock_guard lock(_mtx);
         if (_is_end) {
             return;
         }
+        if (_probes) {
+            _probe_state->end.take(_probes);
+        }
         _end_at = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
         _is_end = true;
 
@@ -60,10 +119,20 @@ private:
         if (_uploaded) {
             return;
         }
-        int64_t start = _is_start ? _start_at : _create_at;
-        int64_t end = _is_end ? _end_at : duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+        if (_probes && !_is_end) {
+            _probe_state->end.take(_probes);
+        }
+        Sample sample;
+        sample.start_us = _is_start ? _start_at : _create_at;
+        sample.end_us = _is_end ? _end_at : duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+        if (_probes) {
+            ProbeSnapshot::diff(_probe_state->begin, _probe_state->end, sample.end_us - sample.start_us, sample.metrics);
+        }
+        if (_probes & kProbeAlloc) {
+            _probe_state->alloc_scope.end(sample.metrics);
+        }
 
-        _cb(_name, start, end);
+        _cb(_name, sample);
         _uploaded = true;
     }
 
@@ -76,6 +145,15 @@ private:
     int64_t _start_at, _end_at;
     bool _is_start, _is_end;
     bool _uploaded;
+
+    uint32_t _probes;
+    OverheadCounter *_overhead;
+    // 探针的采样结果，只在打开了探针时分配，默认配置下记录保持小对象
+    struct ProbeState {
+        ProbeSnapshot begin, end;
+        AllocScope alloc_scope;
+    };
+    std::unique_ptr<ProbeState> _probe_state;
 };
 
 // bthread safe
@@ -89,17 +167,28 @@ public:
     explicit TimeCounter() {}
     ~TimeCounter() {}
     
+    // 之后新建的记录默认打开的探针，见 Probe
+    void set_probes(uint32_t probes) {
+        _probes.store(probes, std::memory_order_relaxed);
+    }
+
+    uint32_t probes() const {
+        return _probes.load(std::memory_order_relaxed);
+    }
+
     // 同名的记录会合并，上报时，所有记录都会上传
     std::shared_ptr<TimeRecorder> add_recorder(const std::string &name) {
-        auto rc = std::make_shared<TimeRecorder>(name, [this](const std::string &name, int64_t start_us, int64_t end_us) {
-            std::lock_guard lock(_spans_mtx);
-            // 合并时，start 取 min，end 取 max
-            if (!_spans.count(name)) {
-                _spans[name] = std::make_pair(start_us, end_us);
-            }
-            _spans[name].first = std::min(_spans[name].first, start_us);
-            _spans[name].second = std::max(_spans[name].second, end_us);
-        });
+        return add_recorder(name, probes());
+    }
+
+    std::shared_ptr<TimeRecorder> add_recorder(const std::string &name, uint32_t probes) {
+        OverheadScope overhead_scope(_overhead);
+        // 记录自己的对象、探针状态和 _trs 的分配不计入外层记录
+        alloc::SuppressScope alloc_suppress;
+        probes = Overhead::Instance().effective_probes(probes);
+        auto rc = std::make_shared<TimeRecorder>(name, [this](const std::string &name, const TimeRecorder::Sample &sample) {
+            add_sample(name, sample);
+        }, probes, &_overhead);
 
         std::lock_guard lock(_trs_mtx);
         _trs.push_back(std::weak_ptr<TimeRecorder>(rc));
@@ -107,43 +196,252 @@ public:
         return rc;
     }
 
-    std::string report() {
-        // report 时，所有记录都会上传
-        std::lock_guard lock(_trs_mtx);
-        for (auto&& tr : _trs) {
-            auto real_tr = tr.lock();
-            if (real_tr) {
-                real_tr->end();
+    // 直接合并一次已经完成的记录，和记录上传走同一条路径；用于不适合用 TimeRecorder 计时的场景（如协程）
+    void add_sample(const std::string &name, const TimeRecorder::Sample &sample) {
+        OverheadScope overhead_scope(_overhead);
+        alloc::SuppressScope alloc_suppress;
+        {
+            std::lock_guard lock(_spans_mtx);
+            merge(name, sample.start_us, sample.end_us, sample.metrics);
+        }
+        // 进程级聚合按单次记录统计，不受同名合并影响
+        auto& stats = SpanStats::Instance();
+        if (stats.enabled() && Overhead::Instance().stats_allowed()) {
+            stats.record(name, sample.end_us - sample.start_us);
+        }
+    }
+
+    // 批量导入外部测得的区间（例如下游 RPC 返回的分段耗时），元素是 SpanRecord
+    // 整批只加一次锁、只遍历一次（可以是单次遍历的输入 range），合并规则和 add_sample 相同
+    // 和 add_sample 一样在锁外记录进程级统计：遍历时先记下耗时，解锁后再交给 SpanStats
+    template <typename Range>
+    void add_spans(const Range &spans) {
+        OverheadScope overhead_scope(_overhead);
+        alloc::SuppressScope alloc_suppress;
+        auto& stats = SpanStats::Instance();
+        bool record_stats = stats.enabled() && Overhead::Instance().stats_allowed();
+        std::vector<std::pair<std::string, int64_t>> durations;
+        {
+            std::lock_guard lock(_spans_mtx);
+            for (const SpanRecord &span : spans) {
+                merge(span.name, span.start_us, span.end_us, span.metrics);
+                if (record_stats) {
+                    durations.emplace_back(span.name, span.end_us - span.start_us);
+                }
             }
         }
+        for (auto& [name, duration_us] : durations) {
+            stats.record(name, duration_us);
+        }
+    }
+
+    // 把合并后的 span 编码成跨服务传递的格式（见 binary::append_spans），追加到 out
+    // 和 report 一样会结束所有未结束的记录
+    void serialize_spans(std::string &out) {
+        std::vector<SpanRecord> spans;
+        collect(spans);
+        binary::append_spans(out, spans, duration_cast<microseconds>(system_clock::now().time_since_epoch()).count());
+    }
+
+    // 合并下游服务 serialize_spans 的结果，span 名字加上 prefix，不计入进程级的 SpanStats
+    // call_start_us / call_end_us 是本地发起调用和收到响应的时间，用来修正两边的时钟偏差：
+    // 假设请求和响应的网络耗时相同，把下游的 [base_us, clock_us] 放在调用区间的正中；
+    // 不提供调用区间时，认为收到的时刻就是下游编码的时刻
+    // 数据不完整时不合并任何 span，返回 false
+    bool merge_remote(std::string_view prefix, std::string_view bytes,
+            int64_t call_start_us = 0, int64_t call_end_us = 0) {
+        OverheadScope overhead_scope(_overhead);
+        alloc::SuppressScope alloc_suppress;
+        binary::Reader reader(bytes);
+        binary::SpansHeader header;
+        if (!binary::read_spans_header(reader, header) || header.count > reader.remaining()) {
+            return false;
+        }
 
-        // 生成字符串
-        std::vector<std::string> view;
-        std::transform(_spans.begin(), _spans.end(), 
-            std::back_inserter(view), 
-            [](auto&& item) {
-                // 或者直接返回
-                char buffer[100]; // 确保缓冲区足够大
-                snprintf(buffer, sizeof(buffer), "[%s: %.3f(ms)]", 
-                        item.first.c_str(), 
-                        (item.second.second - item.second.first) / 1000.0);
-                return std::string(buffer);
+        int64_t offset_us;
+        if (call_end_us > call_start_us) {
+            offset_us = (call_start_us + call_end_us) / 2 - (header.base_us + header.clock_us) / 2;
+        } else {
+            offset_us = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count() - header.clock_us;
+        }
+
+        // 先完整解析再加锁合并，名字只在合并时拷贝
+        struct RemoteSpan {
+            std::string_view name;
+            int64_t start_us;
+            int64_t end_us;
+        };
+        std::vector<RemoteSpan> spans(header.count);
+        for (auto& span : spans) {
+            if (!binary::read_span(reader, header, span.name, span.start_us, span.end_us)) {
+                return false;
             }
-        );
+        }
+
+        std::string name(prefix);
+        std::lock_guard lock(_spans_mtx);
+        for (auto& span : spans) {
+            name.resize(prefix.size());
+            name.append(span.name.data(), span.name.size());
+            merge(name, span.start_us + offset_us, span.end_us + offset_us, SpanMetrics{});
+        }
+        return true;
+    }
+
+    std::string report() {
+        std::vector<SpanRecord> spans;
+        collect(spans);
 
         std::string result;
-        if (!view.empty()) {
-            result = view[0];
-            for (size_t i = 1; i < view.size(); ++i) {
-                result += " " + view[i];
+        append_spans_text(result, spans);
+        return result;
+    }
+
+    // report 的结构化版本：结束所有记录，按 name 排序输出合并后的 span
+    // 结束记录时不持有 _trs_mtx：记录的 end 要拿记录自己的锁和 _spans_mtx，和并发的 add_recorder 互不阻塞；
+    // 拷贝指针之后新建的记录不在这次 report 里
+    void collect(std::vector<SpanRecord>& out) {
+        OverheadScope overhead_scope(_overhead);
+        alloc::SuppressScope alloc_suppress;
+        // report 时，所有记录都会上传
+        for (auto& tr : live_recorders()) {
+            tr->end();
+        }
+
+        std::lock_guard lock(_spans_mtx);
+        out.reserve(out.size() + _spans.size());
+        for (auto& item : _spans) {
+            out.push_back(SpanRecord{item.first, item.second.start_us, item.second.end_us, item.second.metrics});
+        }
+    }
+
+    // 不结束任何记录的快照，用于长请求（如流式 RPC）的周期性输出
+    // 已完成的 span 按 name 合并；未结束的记录各自单独列出，标记 in_progress，时长算到快照的时刻
+    // incremental 为 true 时只输出上一次增量快照之后完成的记录：同名的按同样的规则合并，不含更早的记录；
+    // 第一次增量快照输出全部。增量的基线只由增量快照推进，全量快照不影响；每个 TimeCounter 只有一个增量基线
+    // 未结束的记录总是输出；输出按 name 排序
+    void snapshot(std::vector<SpanRecord>& out, bool incremental = false) {
+        OverheadScope overhead_scope(_overhead);
+        alloc::SuppressScope alloc_suppress;
+        size_t begin = out.size();
+        {
+            std::lock_guard lock(_spans_mtx);
+            if (!incremental) {
+                for (auto& item : _spans) {
+                    out.push_back(SpanRecord{item.first, item.second.start_us, item.second.end_us, item.second.metrics});
+                }
+            } else if (!_incremental) {
+                // 第一次增量快照，之后开始记录增量
+                for (auto& item : _spans) {
+                    out.push_back(SpanRecord{item.first, item.second.start_us, item.second.end_us, item.second.metrics});
+                }
+                _incremental = true;
+            } else {
+                // 只遍历有增量的 span
+                for (auto it : _dirty) {
+                    SpanAgg::Delta& delta = it->second.delta;
+                    out.push_back(SpanRecord{it->first, delta.start_us, delta.end_us, delta.metrics});
+                    delta.valid = false;
+                }
+                _dirty.clear();
+                std::sort(out.begin() + begin, out.end(), [](const SpanRecord& a, const SpanRecord& b) {
+                    return a.name < b.name;
+                });
             }
         }
-        return result;
+
+        auto live = live_recorders();
+        size_t finished = out.size();
+        int64_t now = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+        SpanRecord span;
+        for (auto& tr : live) {
+            if (tr->peek(now, span)) {
+                out.push_back(span);
+            }
+        }
+        auto by_name = [](const SpanRecord& a, const SpanRecord& b) { return a.name < b.name; };
+        std::sort(out.begin() + finished, out.end(), by_name);
+        std::inplace_merge(out.begin() + begin, out.begin() + finished, out.end(), by_name);
+    }
+
+    // 计时器自身的累计开销，见 Overhead
+    const OverheadCounter& overhead() const {
+        return _overhead;
+    }
+
+    OverheadCounter& overhead() {
+        return _overhead;
     }
 
 private:
+    // 同名记录合并后的结果
+    struct SpanAgg {
+        int64_t start_us;
+        int64_t end_us;
+        SpanMetrics metrics;
+
+        // 上一次增量快照之后合并进来的记录
+        struct Delta {
+            bool valid = false;
+            int64_t start_us = 0;
+            int64_t end_us = 0;
+            SpanMetrics metrics;
+        } delta;
+    };
+
+    // 拷贝还活着的记录的指针，只在拷贝时持有 _trs_mtx
+    // 顺便清掉已经析构的记录，长请求里 _trs 不会一直增长
+    std::vector<std::shared_ptr<TimeRecorder>> live_recorders() {
+        std::vector<std::shared_ptr<TimeRecorder>> live;
+        std::lock_guard lock(_trs_mtx);
+        live.reserve(_trs.size());
+        auto alive = std::remove_if(_trs.begin(), _trs.end(), [&live](const std::weak_ptr<TimeRecorder>& tr) {
+            auto real_tr = tr.lock();
+            if (!real_tr) {
+                return true;
+            }
+            live.push_back(std::move(real_tr));
+            return false;
+        });
+        _trs.erase(alive, _trs.end());
+        return live;
+    }
+
+    // 调用方持有 _spans_mtx；合并时，start 取 min，end 取 max，指标累加
+    void merge(const std::string &name, int64_t start_us, int64_t end_us, const SpanMetrics &metrics) {
+        auto it = _spans.find(name);
+        if (it == _spans.end()) {
+            it = _spans.emplace(name, SpanAgg{start_us, end_us, metrics, {}}).first;
+        } else {
+            it->second.start_us = std::min(it->second.start_us, start_us);
+            it->second.end_us = std::max(it->second.end_us, end_us);
+            it->second.metrics.merge(metrics);
+        }
+        if (!_incremental) {
+            return;
+        }
+        SpanAgg::Delta& delta = it->second.delta;
+        if (!delta.valid) {
+            delta.valid = true;
+            delta.start_us = start_us;
+            delta.end_us = end_us;
+            delta.metrics = metrics;
+            _dirty.push_back(it);
+        } else {
+            delta.start_us = std::min(delta.start_us, start_us);
+            delta.end_us = std::max(delta.end_us, end_us);
+            delta.metrics.merge(metrics);
+        }
+    }
+
+    std::atomic<uint32_t> _probes{kProbeNone};
+    OverheadCounter _overhead;
+
     std::mutex _spans_mtx;
-    std::map<std::string, std::pair<int64_t, int64_t>> _spans;
+    std::map<std::string, SpanAgg> _spans;
+    // 增量快照的状态，由 _spans_mtx 保护；第一次增量快照之后才开始记录增量
+    bool _incremental = false;
+    std::vector<std::map<std::string, SpanAgg>::iterator> _dirty;   // 有增量的 span
 
     std::mutex _trs_mtx;
     std::vector<std::weak_ptr<TimeRecorder>> _trs;
@@ -1,27 +1,46 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <map>
 #include <vector>
 #include <mutex>
 #include <sstream>
 #include <unordered_map>
 #include <unordered_set>
-#include <queue>
+#include <cstdint>
 #include <string>
 #include <atomic>
 #include <thread>
-
+#include <string_view>
+#include <type_traits>
+
+#include "timekeeper/async_emitter.hpp"
+#include "timekeeper/log_fields.hpp"
+#include "timekeeper/overhead.hpp"
+#include "timekeeper/record.hpp"
+#include "timekeeper/span_stats.hpp"
 #include "timekeeper/time_counter.hpp"
 
+// 创建、删除 key 时的调试日志，默认不编译：每条日志都要拿进程级的 stdout 锁并 flush，
+// 放在 Init 和析构路径上会让所有请求的准入串行化。需要时定义 TIMEKEEPER_DEBUG_LOG 打开
+#ifdef TIMEKEEPER_DEBUG_LOG
+#define TIMEKEEPER_DLOG(expr) (std::cout << expr << std::endl)
+#else
+#define TIMEKEEPER_DLOG(expr) ((void)0)
+#endif
+
 namespace timekeeper {
 
 class ThreadData {
 private:
     std::string _logid;
     std::unique_ptr<TimeCounter> _tc;
-    std::map<std::string, std::string> _log_fields;
+    LogFields _log_fields;
     std::mutex _mtx;
+    bool _overhead_reported = false;
+    std::atomic<uint32_t> _aliases{0};
 
 public:
     // 默认构造函数，初始化 TimeCounter
@@ -33,15 +52,49 @@ public:
     }
 
     std::string report() {
-        std::lock_guard lock(_mtx);
+        RequestRecord record = make_record();
+        // 格式化发生在请求结算之后，单独计入进程级的开销统计
+        OverheadScope overhead_scope(_tc->overhead(), true);
+        alloc::SuppressScope alloc_suppress;
+        return format_record(record);
+    }
+
+    // report 的结构化版本，同样会结束所有未结束的记录
+    // 打开了 Overhead 统计时，追加一个 "__timekeeper_overhead" span，从请求开始算起，长度是计时器自身的开销
+    // 结束记录（collect）时不持有 _mtx，并发的 add_recorder、add_log_field 不会被 report 阻塞
+    RequestRecord make_record() {
+        RequestRecord record;
+        {
+            std::lock_guard lock(_mtx);
+            fill_record_head(record);
+        }
+        _tc->collect(record.spans);
+        if (Overhead::Instance().enabled()) {
+            std::lock_guard lock(_mtx);
+            append_overhead_span(record.spans);
+        }
+        return record;
+    }
+
+    // 不结束记录的快照，见 TimeCounter::snapshot；不追加开销 span，也不计入进程级的开销统计
+    std::string snapshot(bool incremental = false) {
+        return format_record(make_snapshot(incremental));
+    }
 
-        std::stringstream ss;
-        ss << "[logid: " << _logid << "]";
-        for (auto& item : _log_fields) {
-            ss << " [" << item.first << ": " << item.second << "]";
+    RequestRecord make_snapshot(bool incremental = false) {
+        RequestRecord record;
+        {
+            std::lock_guard lock(_mtx);
+            fill_record_head(record);
         }
-        ss << " " << _tc->report();
-        return ss.str();
+        _tc->snapshot(record.spans, incremental);
+        return record;
+    }
+
+    // 把结构化数据交给后台线程格式化并输出，请求线程上不做格式化和 IO
+    // 队列满时按 emitter 的策略丢弃或等待，返回是否入队
+    bool emit_async(AsyncEmitter& emitter = AsyncEmitter::Instance()) {
+        return emitter.push(make_record());
     }
 
     void set_log_id(const std::string& logid) {
@@ -60,282 +113,614 @@ public:
         return _tc->add_recorder(name);
     }
 
-    void add_log_field(const std::string& key, const std::string& value, bool need_overwrite = false) {
+    // 指定这条记录打开的探针，见 Probe
+    std::shared_ptr<TimeRecorder> add_recorder(const std::string& name, uint32_t probes) {
+        std::lock_guard lock(_mtx);
+        return _tc->add_recorder(name, probes);
+    }
+
+    // 合并一次已经完成的记录，见 TimeCounter::add_sample
+    // 和 add_spans 一样由 TimeCounter 自己加锁，这里不持有 _mtx
+    void add_sample(const std::string& name, const TimeRecorder::Sample& sample) {
+        _tc->add_sample(name, sample);
+    }
+
+    // 批量导入外部测得的区间，元素是 SpanRecord，见 TimeCounter::add_spans
+    // TimeCounter 自己加锁，这里不持有 _mtx，整批只加一次锁
+    template <typename Range>
+    void add_spans(const Range& spans) {
+        _tc->add_spans(spans);
+    }
+
+    // 编码本请求的 span，随响应返回给上游，见 TimeCounter::serialize_spans
+    // TimeCounter 自己加锁，这里不持有 _mtx，结束记录时不阻塞别的调用
+    std::string serialize_spans() {
+        std::string out;
+        _tc->serialize_spans(out);
+        return out;
+    }
+
+    // 合并下游服务返回的 span，见 TimeCounter::merge_remote
+    bool merge_remote(std::string_view prefix, std::string_view bytes,
+            int64_t call_start_us = 0, int64_t call_end_us = 0) {
+        return _tc->merge_remote(prefix, bytes, call_start_us, call_end_us);
+    }
+
+    // 同一个 logid 被重复 Init（例如上游重试）时登记一个别名，返回别名编号（从 1 开始）
+    // 别名数大于 0 时 report 多一个 "__aliases" 字段
+    uint32_t add_alias() {
+        return _aliases.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    uint32_t alias_count() const {
+        return _aliases.load(std::memory_order_relaxed);
+    }
+
+    // 之后新建的记录默认打开的探针
+    void set_probes(uint32_t probes) {
+        _tc->set_probes(probes);
+    }
+
+    // 同名字段默认首次写入生效，need_overwrite 为 true 时覆盖
+    // 数值、布尔类型的字段直接存储，格式化推迟到 report；各类型的映射见 LogValue 的构造函数
+    void add_log_field(std::string_view key, LogValue value, bool need_overwrite = false) {
+        OverheadScope overhead_scope(_tc->overhead());
+        alloc::SuppressScope alloc_suppress;
+        std::lock_guard lock(_mtx);
+        _log_fields.set(key, std::move(value), need_overwrite);
+    }
+
+    // 批量写入字段，元素是 (key, LogValue) 的 pair，例如 RequestRecord::fields；整批只加一次锁
+    template <typename Range>
+    void add_log_fields(const Range& fields, bool need_overwrite = false) {
+        OverheadScope overhead_scope(_tc->overhead());
+        alloc::SuppressScope alloc_suppress;
         std::lock_guard lock(_mtx);
-        if (_log_fields.count(key) && !need_overwrite) {
+        // 能多次遍历的 range 先预留空间，单次遍历的输入 range 直接写入
+        using Iterator = decltype(std::begin(fields));
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag,
+                typename std::iterator_traits<Iterator>::iterator_category>) {
+            _log_fields.reserve(_log_fields.size() + std::distance(std::begin(fields), std::end(fields)));
+        }
+        for (const auto& [key, value] : fields) {
+            _log_fields.set(key, value, need_overwrite);
+        }
+    }
+
+private:
+    // 调用方持有 _mtx；填入 logid 和字段
+    void fill_record_head(RequestRecord& record) {
+        OverheadScope overhead_scope(_tc->overhead());
+        alloc::SuppressScope alloc_suppress;
+        record.logid = _logid;
+        record.fields.reserve(_log_fields.size());
+        _log_fields.for_each_sorted([&record](const std::string& key, const LogValue& value) {
+            record.fields.emplace_back(key, value);
+        });
+        if (uint32_t aliases = _aliases.load(std::memory_order_relaxed)) {
+            append_aliases_field(record.fields, aliases);
+        }
+    }
+
+    // 保持按 key 排序
+    static void append_aliases_field(std::vector<std::pair<std::string, LogValue>>& fields, uint32_t aliases) {
+        static const std::string kKey = "__aliases";
+        auto it = std::lower_bound(fields.begin(), fields.end(), kKey, [](const auto& field, const std::string& key) {
+            return field.first < key;
+        });
+        fields.emplace(it, kKey, LogValue(static_cast<int64_t>(aliases)));
+    }
+
+    // 调用方持有 _mtx；进程级计数每个请求只累加一次，重复 report 不会重复计入
+    void append_overhead_span(std::vector<SpanRecord>& spans) {
+        if (spans.empty()) {
             return;
         }
-        _log_fields[key] = value;
-    }  
+        int64_t begin_us = spans[0].start_us;
+        int64_t end_us = spans[0].end_us;
+        for (auto& span : spans) {
+            begin_us = std::min(begin_us, span.start_us);
+            end_us = std::max(end_us, span.end_us);
+        }
+        uint64_t ticks = _tc->overhead().ticks();
+        if (!_overhead_reported) {
+            Overhead::Instance().on_request(ticks, end_us - begin_us);
+            _overhead_reported = true;
+        }
+
+        static const std::string kName = "__timekeeper_overhead";
+        int64_t overhead_us = static_cast<int64_t>(ticks * overhead::ns_per_tick() / 1000);
+        // 保持按 name 排序
+        auto it = std::lower_bound(spans.begin(), spans.end(), kName, [](const SpanRecord& span, const std::string& name) {
+            return span.name < name;
+        });
+        spans.insert(it, SpanRecord{kName, begin_us, begin_us + overhead_us});
+    }
+};
+
+// 请求上下文：当前请求 ThreadData 的引用，用于把请求带到别的线程/线程池任务里
+// 在父线程 ThreadDataManager::Capture()，在子线程用 ContextScope 挂上，
+// 挂上期间 GetCurrentThreadData() 直接返回这个 ThreadData，不经过全局 map，子任务的记录计入父请求
+class Context {
+public:
+    Context() = default;
+    explicit Context(std::shared_ptr<ThreadData> data) : _data(std::move(data)) {}
+
+    explicit operator bool() const { return static_cast<bool>(_data); }
+    ThreadData* operator->() const { return _data.get(); }
+    const std::shared_ptr<ThreadData>& data() const { return _data; }
+
+private:
+    std::shared_ptr<ThreadData> _data;
 };
 
 // 模板类，表示一个分层结构的键-数据映射关系
-template <typename DataType, typename MutexType=std::mutex>
+// 按 key 的哈希分成 ShardCount 个分片，每个分片一把锁，不同 key 的操作互不阻塞
+// 子节点挂在父节点上，由父 key 所在分片的锁保护；同时涉及父子两个分片时按 std::scoped_lock 的顺序加锁
+//
+// 删除一个 key 时只在它的分片锁内摘下这个节点，把它的子节点列表整个挂到待回收列表上（O(1)），删除本身不做回收；
+// 子树交给延迟回收：之后的 AddData / FindOrAdd 每次顺带回收最多 kReclaimBatch 个子 key，
+// 待回收的不超过 kDrainThreshold 个时一次回收完，这样一波删除之后的下一次添加通常就能清空列表
+// 大批删除之后如果 map 空闲下来，剩下的子 key 不会自动回收，需要调用 ReclaimAll()（或 Reclaim()）主动回收
+// 回收前子 key 仍然可以查到，回收时才从 map 删除并标记 removed
+template <typename DataType, typename MutexType=std::mutex, size_t ShardCount=64>
 class HierarchicalMap {
 public:
     using DataPtr = std::shared_ptr<DataType>;  // 数据的共享指针类型
 
+    // map 里的一个节点，每次 AddData 新建；从 map 删除或被覆盖时 removed 置为 true
+    // 调用方可以缓存节点（的 weak_ptr），用 removed 廉价地判断这个 key 是否还在 map 里
+    struct Node {
+        DataPtr data;
+        std::atomic<bool> removed{false};
+        std::vector<std::pair<std::string, std::shared_ptr<Node>>> children;  // 子 key 和子节点
+    };
+    using NodePtr = std::shared_ptr<Node>;
+    using Children = std::vector<std::pair<std::string, NodePtr>>;
+
     // KeyGuard 使用 shared_ptr 来管理 DataType 数据，并包含自定义的 deleter
     using KeyGuard = std::shared_ptr<DataType>;
 
+    // 每次顺带回收的子 key 数量上限
+    static constexpr size_t kReclaimBatch = 16;
+    // 待回收的子 key 不超过这个数量时一次回收完
+    static constexpr size_t kDrainThreshold = 4 * kReclaimBatch;
+
     // 添加数据到映射中
     // 参数：key 表示要添加的键，data 表示要添加的数据，baseKey（可选）表示继承的数据键
-    void AddData(const std::string& key, DataPtr data, const std::string& baseKey = "") {
-        std::lock_guard lock(mutex_);  // 确保线程安全
+    // 返回：新建的节点
+    NodePtr AddData(const std::string& key, DataPtr data, const std::string& baseKey = "") {
+        ReclaimSome();
+        Shard& shard = shard_for(key);
+        if (baseKey.empty()) {
+            std::lock_guard lock(shard.mutex);
+            return insert(shard, key, std::move(data));
+        }
 
-        // 如果提供了 baseKey，继承 baseKey 的数据
-        if (!baseKey.empty()) {
-            if (!map_.count(baseKey)) {
-                // 有问题，提供了 basekey map 里一定有
-                std::cerr << "there is no basekey in map, basekey: " << baseKey
-                    << " key: " << key << std::endl;
-            } else {
-                children_[baseKey].insert(key);  // baseKey 的子节点添加新键
-                data = map_[baseKey];  // 共享 baseKey 的数据
-            }
+        Shard& base = shard_for(baseKey);
+        if (&base == &shard) {
+            std::lock_guard lock(shard.mutex);
+            return insert_child(base, baseKey, shard, key, std::move(data));
         }
+        std::scoped_lock lock(base.mutex, shard.mutex);
+        return insert_child(base, baseKey, shard, key, std::move(data));
+    }
 
-        map_[key] = data;  // 添加或更新键-数据映射
-        children_.emplace(key, std::unordered_set<std::string>{});  // 初始化子节点集合
+    // 原子地查找或插入：key 已存在时返回已有节点，inserted 为 false；
+    // 否则用 make_data() 创建数据插入，inserted 为 true。make_data 在分片锁内调用，应当足够轻
+    template <typename MakeData>
+    NodePtr FindOrAdd(const std::string& key, MakeData&& make_data, bool& inserted) {
+        ReclaimSome();
+        Shard& shard = shard_for(key);
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it != shard.map.end()) {
+            inserted = false;
+            return it->second;
+        }
+        inserted = true;
+        return insert(shard, key, make_data());
     }
 
     // 查找数据
     // 参数：key 表示要查找的键
     // 返回：如果找到则返回对应的数据指针，否则返回空指针
     DataPtr FindData(const std::string& key) {
-        std::lock_guard lock(mutex_);  // 确保线程安全
-        auto it = map_.find(key);
-        return (it != map_.end()) ? it->second : nullptr;  // 如果找到返回数据指针，否则返回空指针
+        Shard& shard = shard_for(key);
+        std::lock_guard lock(shard.mutex);  // 确保线程安全
+        auto it = shard.map.find(key);
+        return (it != shard.map.end()) ? it->second->data : nullptr;  // 如果找到返回数据指针，否则返回空指针
+    }
+
+    // 查找节点，找不到返回空指针
+    NodePtr FindNode(const std::string& key) {
+        Shard& shard = shard_for(key);
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.map.find(key);
+        return (it != shard.map.end()) ? it->second : nullptr;
     }
 
     // 返回 KeyGuard，用于管理键的生命周期，如果找不到 key 则返回空指针
-    // KeyGuard 是一个 shared_ptr，带有自定义 deleter 用于删除键及其子节点
+    // KeyGuard 是一个 shared_ptr，带有自定义 deleter 用于删除键，子节点延迟回收
+    // 删除时只删除取 KeyGuard 时的那个节点，key 期间被覆盖时不影响新的节点
     KeyGuard GetKeyGuard(const std::string& key) {
-        std::lock_guard lock(mutex_);  // 确保线程安全
-        auto it = map_.find(key);
-        if (it == map_.end()) {
+        Shard& shard = shard_for(key);
+        std::lock_guard lock(shard.mutex);  // 确保线程安全
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) {
             return nullptr;  // 如果找不到键，返回空指针
         }
 
-        DataPtr data = it->second;
+        NodePtr node = it->second;
 
         // 创建一个带有自定义 deleter 的 shared_ptr
-        // 当引用计数降为零时，调用 RemoveKeyRecursive 递归删除
-        return KeyGuard(data.get(), [this, key, data](DataType* ptr) {
+        // 当引用计数降为零时，调用 RemoveKey 删除
+        return KeyGuard(node->data.get(), [this, key, node](DataType*) {
             if (!this) {
                 return;
             }
-            std::lock_guard lock(mutex_);  // 确保删除过程是线程安全的
-            RemoveKeyRecursive(key);  // 递归删除键及其子节点
+            RemoveKey(key, node);
         });
     }
 
-private:
-    // 递归删除指定键及其子节点
-    // 参数：key 表示要删除的键
-    void RemoveKeyRecursive(const std::string& key) {
-        std::queue<std::string> keys_to_remove;  // 用于广度优先遍历的队列
-        keys_to_remove.push(key);
-        std::vector<std::string> removed_keys;
-        removed_keys.push_back(key);
-
-        // 循环直到所有子节点都被删除
-        while (!keys_to_remove.empty()) {
-            auto current = keys_to_remove.front();
-            keys_to_remove.pop();
-
-            // 查找当前键的子节点
-            if (auto childIt = children_.find(current); childIt != children_.end()) {
-                // 将所有子节点添加到待删除队列中
-                for (const auto& child : childIt->second) {
-                    keys_to_remove.push(child);
-                    removed_keys.push_back(child);
+    // 回收最多 max_keys 个待删除的子 key，返回实际回收的数量
+    size_t Reclaim(size_t max_keys = SIZE_MAX) {
+        size_t reclaimed = 0;
+        while (reclaimed < max_keys) {
+            Children batch;
+            {
+                std::lock_guard lock(pending_mutex_);
+                if (pending_.empty()) {
+                    break;
                 }
-                children_.erase(childIt);  // 删除子节点记录
+                // 从最后一个列表的尾部取，整个列表都要回收时直接拿走
+                Children& last = pending_.back();
+                size_t n = std::min(max_keys - reclaimed, last.size());
+                if (n == last.size()) {
+                    batch.swap(last);
+                    pending_.pop_back();
+                } else {
+                    batch.assign(std::make_move_iterator(last.end() - n), std::make_move_iterator(last.end()));
+                    last.resize(last.size() - n);
+                }
+                pending_size_.store(pending_size_.load(std::memory_order_relaxed) - n, std::memory_order_relaxed);
+            }
+            for (auto& [key, node] : batch) {
+                unlink(key, node);
             }
+            reclaimed += batch.size();
+        }
+        return reclaimed;
+    }
+
+    // 回收所有待删除的子 key（包括回收过程中新摘下的孙子 key），返回回收的数量
+    // 开销和待回收的子树大小成正比，适合在空闲时、定时任务里或退出前调用
+    size_t ReclaimAll() {
+        return Reclaim(SIZE_MAX);
+    }
 
-            map_.erase(current);  // 删除当前键的数据
+    // 等待回收的子 key 数量
+    size_t PendingCount() const {
+        return pending_size_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Shard {
+        std::unordered_map<std::string, NodePtr> map;  // 存储键-数据映射
+        MutexType mutex;
+    };
+
+    Shard& shard_for(const std::string& key) {
+        return shards_[std::hash<std::string>()(key) % ShardCount];
+    }
+
+    // 调用方持有 shard 的锁
+    NodePtr insert(Shard& shard, const std::string& key, DataPtr data) {
+        auto node = std::make_shared<Node>();
+        node->data = std::move(data);
+        auto& slot = shard.map[key];
+        if (slot) {
+            // 覆盖已有的 key 时子节点归新节点
+            node->children.swap(slot->children);
+            slot->removed.store(true, std::memory_order_release);
+        }
+        slot = node;  // 添加或更新键-数据映射
+        return node;
+    }
+
+    // 调用方持有 base 和 shard 的锁（可能是同一个分片）
+    NodePtr insert_child(Shard& base, const std::string& baseKey, Shard& shard, const std::string& key, DataPtr data) {
+        // 如果提供了 baseKey，继承 baseKey 的数据
+        auto it = base.map.find(baseKey);
+        if (it == base.map.end()) {
+            // 有问题，提供了 basekey map 里一定有
+            std::cerr << "there is no basekey in map, basekey: " << baseKey
+                << " key: " << key << std::endl;
+            return insert(shard, key, std::move(data));
+        }
+        NodePtr parent = it->second;
+        NodePtr node = insert(shard, key, parent->data);  // 共享 baseKey 的数据
+        parent->children.emplace_back(key, node);  // baseKey 的子节点添加新键
+        return node;
+    }
+
+    // 从 map 摘下 key 对应的 node（key 已被覆盖时只取走 node 的子节点），子节点放进待回收列表
+    // 返回摘下的子节点数
+    size_t unlink(const std::string& key, const NodePtr& node) {
+        Children children;
+        size_t count = 0;
+        {
+            Shard& shard = shard_for(key);
+            std::lock_guard lock(shard.mutex);
+            if (auto it = shard.map.find(key); it != shard.map.end() && it->second == node) {
+                shard.map.erase(it);  // 删除当前键的数据
+            }
+            node->removed.store(true, std::memory_order_release);
+            children.swap(node->children);
+            count = children.size();
         }
+        if (!children.empty()) {
+            // 整个列表挂上去，不逐个搬运子节点
+            std::lock_guard lock(pending_mutex_);
+            pending_size_.store(pending_size_.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+            pending_.push_back(std::move(children));
+        }
+        return count;
+    }
+
+    // 删除 key，子树延迟回收；这里不回收，删除的开销和待回收的子 key 数量无关
+    void RemoveKey(const std::string& key, const NodePtr& node) {
+        [[maybe_unused]] size_t children = unlink(key, node);
+        TIMEKEEPER_DLOG("[remove key] key is " << key << ", children: " << children);
+    }
 
-        std::stringstream ss;
-        ss << "[begin recursive remove key] parent key is " << removed_keys[0];
-        for (size_t i = 1; i < removed_keys.size(); i++) {
-            ss << " " << removed_keys[i];
+    // 列表较短时整个回收，否则只回收一批，保证单次操作的延迟有上限
+    void ReclaimSome() {
+        size_t pending = pending_size_.load(std::memory_order_relaxed);
+        if (pending > 0) {
+            Reclaim(pending <= kDrainThreshold ? kDrainThreshold : kReclaimBatch);
         }
-        std::cout << ss.str() << std::endl;
     }
 
-    std::unordered_map<std::string, DataPtr> map_;  // 存储键-数据映射
-    std::unordered_map<std::string, std::unordered_set<std::string>> children_;  // 存储键及其子节点的关系
-    MutexType mutex_;
+    Shard shards_[ShardCount];
+
+    std::mutex pending_mutex_;
+    std::vector<Children> pending_;  // 等待回收的子 key，每次删除摘下的子节点列表是一项，都不为空
+    std::atomic<size_t> pending_size_{0};  // 所有列表里子 key 的总数，由 pending_mutex_ 保护写入
+};
+
+using ThreadDataMap = HierarchicalMap<ThreadData, std::mutex>;
+
+// 每个执行单元（线程、bthread、fiber 等）一份的状态，由 StoragePolicy 决定存放在哪里
+struct TaskSlot {
+    std::unique_ptr<std::string> logid;                      // Init 设置的 key
+    uint32_t alias = 0;                                      // 重复 logid 时的别名编号，0 表示是 key 的所有者
+    const std::shared_ptr<ThreadData>* attached = nullptr;   // ContextScope 挂上的上下文
+    // 当前 key 对应的数据的缓存：和 map 节点共享引用计数的 weak_ptr（aliasing）加节点指针
+    // lock 成功时节点一定还活着，再检查节点的 removed 标记确认 key 仍在 map 里
+    std::weak_ptr<ThreadData> cached;
+    const ThreadDataMap::Node* cached_node = nullptr;
+
+    // 交给运行时的析构回调，例如 bthread_key_create(&key, TaskSlot::Destroy)
+    static void Destroy(void* slot) {
+        delete static_cast<TaskSlot*>(slot);
+    }
+};
+
+// 默认的存储方式：线程局部变量，线程退出时释放
+struct ThreadLocalStorage {
+    static TaskSlot& Slot() {
+        static thread_local TaskSlot slot;
+        return slot;
+    }
+};
+
+// 用运行时提供的 getspecific/setspecific 存储，M:N 调度（bthread、boost.fiber 等）下每个任务一份
+// 第一次访问时创建 TaskSlot，释放由运行时负责（注册 TaskSlot::Destroy 作为析构回调），例如 bthread：
+//   bthread_key_t g_key;   // 启动时 bthread_key_create(&g_key, timekeeper::TaskSlot::Destroy)
+//   void* get_slot() { return bthread_getspecific(g_key); }
+//   void set_slot(void* slot) { bthread_setspecific(g_key, slot); }
+//   using BthreadDataManager = timekeeper::BasicThreadDataManager<timekeeper::SpecificStorage<get_slot, set_slot>>;
+template <void* (*Get)(), void (*Set)(void*)>
+struct SpecificStorage {
+    static TaskSlot& Slot() {
+        void* slot = Get();
+        if (!slot) {
+            slot = new TaskSlot();
+            Set(slot);
+        }
+        return *static_cast<TaskSlot*>(slot);
+    }
 };
 
-// 利用 HierarchicalMap 实现线程数据管理，使用 bthreadid 作为key，获取 logid，使用 RAII 的方式实现数据自动删除
-// 全局单例
-class ThreadDataManager {
+// 利用 HierarchicalMap 实现线程数据管理，使用 StoragePolicy 保存当前执行单元的 logid，使用 RAII 的方式实现数据自动删除
+// StoragePolicy 提供 static TaskSlot& Slot()，返回当前执行单元的 TaskSlot，见 ThreadLocalStorage、SpecificStorage
+// 每种 StoragePolicy 一个全局单例
+template <typename StoragePolicy>
+class BasicThreadDataManager {
 public:
     // 获取单例实例
-    static ThreadDataManager& Instance() {
-        static ThreadDataManager instance;  // 使用局部静态变量实现单例
+    static BasicThreadDataManager& Instance() {
+        static BasicThreadDataManager instance;  // 使用局部静态变量实现单例
         return instance;
     }
 
     // 初始化线程数据，传入 logid，传出一个 RAII 的 KeyGuard，销毁时会递归销毁子 key
     // 要保证 KeyGuard 的生命周期 > 所有子 key
     std::shared_ptr<ThreadData> Init(std::string logid) {
-        std::lock_guard lock(_mtx);
-
-        clear_if_exist();
-        _logid_ptr = new std::string(logid);
-
-        auto data_ptr = data_map_.FindData(logid);
-        if (!data_ptr) {
-            // 如果不存在，添加新的数据
-            std::cout << "Adding new ThreadData: " << logid << std::endl;
-            auto new_data = std::shared_ptr<ThreadData>(new ThreadData(logid), [](ThreadData* ptr) {
-                std::cout << "Deleting ThreadData: " << ptr->get_log_id() << std::endl;
+        TaskSlot& slot = StoragePolicy::Slot();
+        clear_if_exist(slot);
+
+        // 查找和插入在同一个分片锁内完成，不同 logid 的 Init 互不阻塞
+        bool inserted = false;
+        auto node = data_map_.FindOrAdd(logid, [&logid] {
+            return std::shared_ptr<ThreadData>(new ThreadData(logid), [](ThreadData* ptr) {
+                TIMEKEEPER_DLOG("Deleting ThreadData: " << ptr->get_log_id());
                 delete ptr;
             });
-            data_map_.AddData(logid, new_data);
+        }, inserted);
+
+        if (inserted) {
+            // 如果不存在，添加新的数据
+            TIMEKEEPER_DLOG("Adding new ThreadData: " << logid);
         } else {
-            // 如果已存在，添加一个 dummy key
-            std::string dummy_key = GenerateDummyKey(logid);
-            std::cout << "Adding dummy key: " << dummy_key
-                << ", for logid: " << logid << std::endl;
-            clear_if_exist();
-            _logid_ptr = new std::string(dummy_key);
-            data_map_.AddData(dummy_key, data_ptr, logid);
-        }
-
-        return GetCurrentThreadData();
-
-
-        // // 设置线程局部存储 logid
-        // clear_if_exist();
-        // bthread_setspecific(bthread_key_, new std::string(logid));
-        
-        // // 检查 logid 是否在 HierarchicalMap 中
-        // auto data_ptr = data_map_.FindData(logid);
-        // if (!data_ptr) {
-        //     // 如果不存在，添加新的数据
-        //     std::cout << "Adding new ThreadData: " << logid << std::endl;
-        //     auto new_data = std::shared_ptr<ThreadData>(new ThreadData(logid), [](ThreadData* ptr) {
-        //         std::cout << "Deleting ThreadData: " << ptr->get_log_id() << std::endl;
-        //         delete ptr;
-        //     });
-        //     data_map_.AddData(logid, new_data);
-        // } else {
-        //     // 如果已存在，添加一个 dummy key
-        //     std::string dummy_key = GenerateDummyKey(logid);
-        //     std::cout << "Adding dummy key: " << dummy_key
-        //         << ", for logid: " << logid << std::endl;
-        //     clear_if_exist();
-        //     bthread_setspecific(bthread_key_, new std::string(dummy_key));
-        //     data_map_.AddData(dummy_key, data_ptr, logid);
-        // }
-
-        // return GetCurrentThreadData();
+            // 如果已存在，作为已有 key 的别名：不往 map 里加 key，只缓存已有的节点
+            // 所有者的 KeyGuard 销毁后节点标记为 removed，别名随之失效
+            slot.alias = node->data->add_alias();
+            TIMEKEEPER_DLOG("Adding alias " << slot.alias << " for logid: " << logid);
+        }
+        slot.logid = std::make_unique<std::string>(std::move(logid));
+
+        return cache(slot, node);
+    }
+
+    // 回收所有延迟删除的子 key，见 HierarchicalMap::ReclaimAll，适合在空闲时调用
+    size_t ReclaimAll() {
+        return data_map_.ReclaimAll();
+    }
+
+    // 进程级按 span 名字聚合的统计，默认关闭，需要先 set_enabled(true)
+    SpanStats& span_stats() {
+        return SpanStats::Instance();
     }
 
     std::shared_ptr<ThreadData> GetKeyGuard() {
-        if (_logid_ptr) {
+        TaskSlot& slot = StoragePolicy::Slot();
+        if (!slot.logid) {
             std::cerr << "ThreadData not initialized";
             return std::make_shared<ThreadData>();
         }
-        auto logid = *_logid_ptr;
-        return data_map_.GetKeyGuard(logid);
+        if (slot.alias) {
+            // 别名不拥有 key，KeyGuard 只是对数据的引用，key 已经删除时返回空指针
+            return cached(slot);
+        }
+        return data_map_.GetKeyGuard(*slot.logid);
+    }
+
+    // 捕获当前线程的请求上下文，没有初始化时返回空的 Context
+    Context Capture() {
+        TaskSlot& slot = StoragePolicy::Slot();
+        if (slot.attached) {
+            return Context(*slot.attached);
+        }
+        if (!slot.logid) {
+            return Context();
+        }
+        if (slot.alias) {
+            return Context(cached(slot));
+        }
+        return Context(data_map_.FindData(*slot.logid));
+    }
 
-        // auto log_ptr = static_cast<std::string*>(bthread_getspecific(bthread_key_));
-        // if (!log_ptr) {
-        //     std::cerr << "ThreadData not initialized";
-        //     return std::make_shared<ThreadData>();
-        // }
-        // auto logid = *log_ptr;
-        // return data_map_.GetKeyGuard(logid);
+    // 底层接口：替换当前线程挂上的上下文，返回之前的值
+    // 指针指向的 shared_ptr 要在挂着期间一直有效；一般用 ContextScope，协程等不能用 RAII 的场景才直接调用
+    static const std::shared_ptr<ThreadData>* ExchangeAttached(const std::shared_ptr<ThreadData>* attached) {
+        TaskSlot& slot = StoragePolicy::Slot();
+        auto previous = slot.attached;
+        slot.attached = attached;
+        return previous;
     }
 
-    // 获取当前线程的数据
+    // 获取当前线程的数据，有 ContextScope 挂着时优先返回挂上的上下文
+    // 热路径只是一次 TLS 访问、weak_ptr::lock 和一次标记比较；缓存失效（节点已删除）时才查 map
     std::shared_ptr<ThreadData> GetCurrentThreadData() {
-        if (!_logid_ptr) {
+        TaskSlot& slot = StoragePolicy::Slot();
+        if (slot.attached) {
+            return *slot.attached;
+        }
+        if (auto data = cached(slot)) {
+            return data;
+        }
+        if (!slot.logid) {
             std::cerr << "ThreadData not initialized";
             return std::make_shared<ThreadData>();
         }
 
-        std::string logid = *_logid_ptr;
-
-        // 查找 HierarchicalMap 中对应的数据
-        auto result = data_map_.FindData(logid);
-        if (!result) {
+        // 查找 HierarchicalMap 中对应的数据；别名只认缓存的节点，节点删除后同名的新 key 不是同一个请求
+        auto node = slot.alias ? nullptr : data_map_.FindNode(*slot.logid);
+        if (!node || !node->data) {
             std::cerr << "ThreadData initialized, but cannot find in map."
-                << ", logid: " << logid;
+                << ", logid: " << *slot.logid;
             return std::make_shared<ThreadData>();
         }
-        return result;
-
-        // auto logid_ptr = static_cast<std::string*>(bthread_getspecific(bthread_key_));
-        // if (!_logid_ptr) {
-        //     std::cerr << "ThreadData not initialized";
-        //     return std::make_shared<ThreadData>();
-        // }
+        return cache(slot, node);
+    }
 
-        // std::string logid = *logid_ptr;
+private:
+    // 缓存的节点仍在 map 里时返回它的数据，否则返回空指针
+    static std::shared_ptr<ThreadData> cached(TaskSlot& slot) {
+        if (auto data = slot.cached.lock()) {
+            if (!slot.cached_node->removed.load(std::memory_order_acquire)) {
+                return data;
+            }
+        }
+        return nullptr;
+    }
 
-        // // 查找 HierarchicalMap 中对应的数据
-        // auto result = data_map_.FindData(logid);
-        // if (!result) {
-        //     std::cerr << "ThreadData initialized, but cannot find in map."
-        //         << ", logid: " << logid;
-        //     return std::make_shared<ThreadData>();
-        // }
-        // return result;
+    // 缓存节点，返回指向节点数据、但和节点共享引用计数的 shared_ptr
+    static std::shared_ptr<ThreadData> cache(TaskSlot& slot, const ThreadDataMap::NodePtr& node) {
+        std::shared_ptr<ThreadData> data(node, node->data.get());
+        slot.cached = data;
+        slot.cached_node = node.get();
+        return data;
     }
 
-private:
-    void clear_if_exist() {
-        if (!_logid_ptr) {
+    void clear_if_exist(TaskSlot& slot) {
+        slot.cached.reset();
+        slot.cached_node = nullptr;
+        slot.alias = 0;
+        if (!slot.logid) {
             return;
         }
-        std::cout << "find old logid: " << *_logid_ptr << ", need to clear it" << std::endl; 
-        delete _logid_ptr;
-        _logid_ptr = nullptr;
-
-        // auto log_ptr = static_cast<std::string*>(bthread_getspecific(bthread_key_));
-        // if (!log_ptr) {
-        //     return;
-        // }
-        // std::cout << "find old logid: " << *log_ptr << ", need to clear it" << std::endl; 
-        // delete log_ptr;
-        // bthread_setspecific(bthread_key_, nullptr);
+        TIMEKEEPER_DLOG("find old logid: " << *slot.logid << ", need to clear it");
+        slot.logid.reset();
     }
 
     // 构造函数私有化以实现单例模式
-    ThreadDataManager() {
-        if (_logid_ptr) {
-            std::cout << "Deleting thread-local data: " << *_logid_ptr << std::endl;
-            delete _logid_ptr;
-        }
+    BasicThreadDataManager() {}
+
+    ThreadDataMap data_map_;  // 用于存储线程数据的 HierarchicalMap
+};
+
+using ThreadDataManager = BasicThreadDataManager<ThreadLocalStorage>;
 
-        // // 初始化 bthread_key_
-        // bthread_key_create(&bthread_key_, [](void* data) {
-        //     // 释放线程局部存储的内存
-        //     auto str_ptr = static_cast<std::string*>(data);
-        //     if (str_ptr) {
-        //         std::cout << "Deleting thread-local data: " << *str_ptr << std::endl;
-        //         delete str_ptr;
-        //     }
-        // });
+// 在当前线程挂上一个请求上下文，析构时恢复之前的上下文，可以嵌套
+// 空的 Context 不改变当前上下文；必须在构造它的执行单元上析构
+template <typename StoragePolicy>
+class BasicContextScope {
+public:
+    explicit BasicContextScope(Context context) : _context(std::move(context)), _active(static_cast<bool>(_context)) {
+        if (_active) {
+            _previous = BasicThreadDataManager<StoragePolicy>::ExchangeAttached(&_context.data());
+        }
     }
 
-    // 生成一个独特的 dummy key
-    std::string GenerateDummyKey(std::string logid) {
-        return "dummy_" + logid + "_" + std::to_string(dummy_counter_.fetch_add(1, std::memory_order_relaxed));
+    ~BasicContextScope() {
+        if (_active) {
+            BasicThreadDataManager<StoragePolicy>::ExchangeAttached(_previous);
+        }
     }
 
-    std::mutex _mtx;
-    static inline thread_local std::string* _logid_ptr = nullptr;
-    // bthread_key_t bthread_key_;  // bthread 特定数据的键
-    HierarchicalMap<ThreadData, std::mutex> data_map_;  // 用于存储线程数据的 HierarchicalMap
-    std::atomic<uint64_t> dummy_counter_ = 0;  // 用于生成 dummy key 的原子计数器
+    // disable copy, assignment, move
+    BasicContextScope(const BasicContextScope &) = delete;
+    BasicContextScope& operator=(const BasicContextScope &) = delete;
+    BasicContextScope(BasicContextScope &&) = delete;
+
+private:
+    Context _context;
+    bool _active;
+    const std::shared_ptr<ThreadData>* _previous = nullptr;
 };
 
-}
\ No newline at end of file
+using ContextScope = BasicContextScope<ThreadLocalStorage>;
+
+// 包装一个可调用对象，执行时挂上 context，用于提交给线程池
+template <typename F>
+auto with_context(Context context, F f) {
+    return [context = std::move(context), f = std::move(f)](auto&&... args) mutable {
+        ContextScope scope(context);
+        return f(std::forward<decltype(args)>(args)...);
+    };
+}
+
+}
@@ -0,0 +1,155 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "timekeeper/binary_format.hpp"
+#include "timekeeper/json.hpp"
+
+// 把 BinaryExporter 写出的二进制文件转换成文本、JSON 或 Chrome trace
+//   timekeeper-decode [--format text|json|chrome] <file>...
+// 不指定文件时从 stdin 读取
+
+namespace {
+
+enum class Format { kText, kJson, kChrome };
+
+void append_json(std::string& out, const timekeeper::RequestRecord& record) {
+    out += "{\"logid\":";
+    timekeeper::append_json_string(out, record.logid);
+    out += ",\"fields\":{";
+    for (size_t i = 0; i < record.fields.size(); ++i) {
+        if (i > 0) {
+            out += ',';
+        }
+        timekeeper::append_json_string(out, record.fields[i].first);
+        out += ':';
+        timekeeper::append_json_value(out, record.fields[i].second);
+    }
+    out += "},\"spans\":[";
+    for (size_t i = 0; i < record.spans.size(); ++i) {
+        auto& span = record.spans[i];
+        if (i > 0) {
+            out += ',';
+        }
+        out += "{\"name\":";
+        timekeeper::append_json_string(out, span.name);
+        out += ",\"start_us\":" + std::to_string(span.start_us);
+        out += ",\"end_us\":" + std::to_string(span.end_us);
+        timekeeper::append_json_span_extras(out, span);
+        out += '}';
+    }
+    out += "]}\n";
+}
+
+// Chrome trace event format，每个请求一个 tid，span 是 "X" 事件，字段、指标和 in_progress 放到 args
+void append_chrome(std::string& out, const timekeeper::RequestRecord& record, uint64_t tid, bool& first) {
+    for (auto& span : record.spans) {
+        out += first ? "\n" : ",\n";
+        first = false;
+        out += "{\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(tid);
+        out += ",\"name\":";
+        timekeeper::append_json_string(out, span.name);
+        out += ",\"ts\":" + std::to_string(span.start_us);
+        out += ",\"dur\":" + std::to_string(span.end_us - span.start_us);
+        out += ",\"args\":{\"logid\":";
+        timekeeper::append_json_string(out, record.logid);
+        for (auto& field : record.fields) {
+            out += ',';
+            timekeeper::append_json_string(out, field.first);
+            out += ':';
+            timekeeper::append_json_value(out, field.second);
+        }
+        timekeeper::append_json_span_extras(out, span);
+        out += "}}";
+    }
+}
+
+int usage(const char* prog) {
+    std::cerr << "usage: " << prog << " [--format text|json|chrome] [file...]" << std::endl;
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Format format = Format::kText;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            std::string f = argv[++i];
+            if (f == "text") {
+                format = Format::kText;
+            } else if (f == "json") {
+                format = Format::kJson;
+            } else if (f == "chrome") {
+                format = Format::kChrome;
+            } else {
+                return usage(argv[0]);
+            }
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            return usage(argv[0]);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        files.push_back("-");
+    }
+
+    std::string out;
+    uint64_t count = 0;
+    bool chrome_first = true;
+    bool corrupted = false;
+    if (format == Format::kChrome) {
+        out += "{\"traceEvents\":[";
+    }
+    for (auto& file : files) {
+        std::string data;
+        if (file == "-") {
+            data.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+        } else {
+            std::ifstream in(file, std::ios::binary);
+            if (!in) {
+                std::cerr << "cannot open file: " << file << std::endl;
+                return 1;
+            }
+            data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        timekeeper::binary::Reader reader(data);
+        timekeeper::RequestRecord record;
+        while (!reader.eof()) {
+            if (!timekeeper::binary::read_record(reader, record)) {
+                std::cerr << "corrupted record in " << file << " after " << count << " records" << std::endl;
+                corrupted = true;
+                break;
+            }
+            switch (format) {
+                case Format::kText:
+                    timekeeper::append_record_text(out, record);
+                    out += '\n';
+                    break;
+                case Format::kJson:
+                    append_json(out, record);
+                    break;
+                case Format::kChrome:
+                    append_chrome(out, record, count, chrome_first);
+                    break;
+            }
+            ++count;
+            if (out.size() >= (1 << 20)) {
+                fwrite(out.data(), 1, out.size(), stdout);
+                out.clear();
+            }
+        }
+    }
+    if (format == Format::kChrome) {
+        out += "\n]}\n";
+    }
+    fwrite(out.data(), 1, out.size(), stdout);
+    // 损坏之前解出的记录照常输出，但用退出码告诉调用方文件不完整
+    return corrupted ? 1 : 0;
+}